@@ -9,6 +9,8 @@ static const float PISUN4 = -4.0 / (PI * PI);
 static const float INVPI2 = 1.0f / PI2;
 static const float NEGHALFPI = -HALFPI;
 static const float EPSILON = 0.0001f;
+static const float SQRT2 = 1.414213562f;
+static const float SQRT3 = 1.732050808f;
 static const float PIDIV180 = 0.01745329251994329576923690768489f;
 
 #endif
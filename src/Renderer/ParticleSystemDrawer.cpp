@@ -25,14 +25,14 @@ void CParticleSystemDrawer::DrawSystem(CParticleSystem* ps) {
 	/*
 	if (ps->DrawParticleForces()) {
 		for (int i = 0; i < ps->numParticles; i++) {
-			Particle* p = ps->getParticle(i);
+			const Particle p = ps->GetParticle(i);
 
 			vec3 c1(0.0f, 0.0f, 1.0f);
-			DrawVector(p->force, p->pos, c1);
+			DrawVector(p.GetForce(), p.GetPos(), c1);
 			vec3 c2(0.0f, 1.0f, 0.0f);
-			DrawVector(p->velocity, p->pos, c2);
+			DrawVector(p.GetVelocity(), p.GetPos(), c2);
 			vec3 c3(1.0f, 0.0f, 0.0f);
-			DrawVector(p->borderForce, p->pos, c3);
+			DrawVector(p.GetBorderForce(), p.GetPos(), c3);
 		}
 	}
 	*/
@@ -41,9 +41,10 @@ void CParticleSystemDrawer::DrawSystem(CParticleSystem* ps) {
 	}
 
 	for (int i = 0; i < ps->numParticles; i++) {
-		Particle* p = ps->GetParticle(i);
+		const Particle p = ps->GetParticle(i);
+		const vec3 pos = p.GetPos();
 
-		const vec3 vAbs = p->velocity.abs() + vec3(0.01f, 0.01f, 0.01f);
+		const vec3 vAbs = p.GetVelocity().abs() + vec3(0.01f, 0.01f, 0.01f);
 
 		const float r = (vAbs.x > 1.0f)? 1.0f - (1.0f / vAbs.x): 1.0f - vAbs.x;
 		const float g = (vAbs.y > 1.0f)? 1.0f - (1.0f / vAbs.y): 1.0f - vAbs.y;
@@ -53,8 +54,8 @@ void CParticleSystemDrawer::DrawSystem(CParticleSystem* ps) {
 
 		glColor4f(color.x, color.y, color.z, 0.8f);
 		glPushMatrix();
-			glTranslatef(p->pos.x, p->pos.y, p->pos.z);
-			glutSolidSphere(p->radius, 10, 10);
+			glTranslatef(pos.x, pos.y, pos.z);
+			glutSolidSphere(p.GetRadius(), 10, 10);
 		glPopMatrix();
 	}
 }
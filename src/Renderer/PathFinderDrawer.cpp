@@ -32,7 +32,7 @@ void CPathFinderDrawer::Draw(CPathFinder* pf, CParticleSystem* ps) {
 	// SphereBlockOffset sanity check
 	vec3 color2 = vec3(1.0f, 1.0f, 1.0f);
 	for (unsigned int i = 0; i < pf->step; i++) {
-		CPathFinder::SphereBlockOffset* sbo = &(pf->sphereBlockOffsets[i]);
+		SphereBlockOffset* sbo = &(pf->sphereBlockOffsets[i]);
 		glPushMatrix();
 		glTranslatef(sbo->x, sbo->y, sbo->z);
 		DrawCube(color2, 0.6f, 1.0f, GL_FILL);
@@ -134,7 +134,7 @@ void DrawSolidTunnelSegment(BoundingCircle* bcm, BoundingCircle* bcn) {
 }
 */
 
-void CPathFinderDrawer::DrawTunnel(CPathFinder* pf, Particle* part) {
+void CPathFinderDrawer::DrawTunnel(CPathFinder* pf, const Particle& part) {
 	if (!pf->showBackBonePath) {
 		return;
 	}
@@ -167,7 +167,7 @@ void CPathFinderDrawer::DrawTunnel(CPathFinder* pf, Particle* part) {
 		glCallList(tunnelList);
 	}
 
-	DrawTunnelSegment(&pf->tunnel[part->sliceIdx], true);
+	DrawTunnelSegment(&pf->tunnel[part.GetSliceIdx()], true);
 }
 
 void CPathFinderDrawer::DrawTunnelSegment(BoundingCircle* bcp, bool hilite) {
@@ -213,39 +213,32 @@ void CPathFinderDrawer::DrawBall(CPathFinder* pf) {
 
 void CPathFinderDrawer::DrawHistory(CPathFinder* pf) {
 	glColor3f(1.0f, 1.0f, 0.0f);
-	vec3 color = vec3(1.0f, 1.0f, 1.0f);
 
-	const int hsize = pf->history.size();
-	const int psize = pf->path.size() - 2;
+	// only the ring keeps records around to draw
+	const CSearchTrace& trace = pf->trace;
+	const unsigned int tsize = trace.GetNumRecords();
 
-	for (int i = 0; i < hsize; i++) {
-		int j = (i < hsize - 1)? i + 1: i;
-		Node* n = dynamic_cast<Node*>(pf->history[i]);
-		Node* o = dynamic_cast<Node*>(pf->history[j]);
+	for (unsigned int i = 0; i < tsize; i++) {
+		const TraceRecord& r = trace.GetRecord(i);
 
-		float x = (float) n->x;
-		float y = (float) n->y;
-		float z = (float) n->z;
-
-		glPushMatrix();
-		glTranslatef(x, y, z);
-
-		// path nodes and links
-		if ((hsize - psize) < i) {
-			vec3 color = vec3(1.0f, 1.0f, 0.0f);
-			vec3 link = o->GetVector() - n->GetVector();
+		// path nodes
+		if (r.IsPathNode()) {
+			Node* n = &pf->map[r.node];
 
+			glPushMatrix();
+			glTranslatef(n->x, n->y, n->z);
 			glutSolidSphere(0.1f, 15, 15);
+			glPopMatrix();
 		}
-		// visited cq. parent nodes
+		// opened nodes cq. their parents
 		else if (pf->showVisitedNodes) {
-			// parent
-			if ((i & 1) == 1) {
-				DrawParent(n, dynamic_cast<Node*>(pf->history[i - 1]));
-			}
-		}
+			Node* p = &pf->map[r.parent];
 
-		glPopMatrix();
+			glPushMatrix();
+			glTranslatef(p->x, p->y, p->z);
+			DrawParent(p, &pf->map[r.node]);
+			glPopMatrix();
+		}
 	}
 }
 
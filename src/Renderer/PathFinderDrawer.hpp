@@ -27,7 +27,7 @@ class CPathFinderDrawer {
 		void DrawCube(const vec3& color, float size, float lineWidth, int mode);
 		void DrawHistory(CPathFinder*);
 		void DrawParent(Node* n, Node* p);
-		void DrawTunnel(CPathFinder*, Particle*);
+		void DrawTunnel(CPathFinder*, const Particle&);
 		void DrawTunnelSegment(BoundingCircle* bc, bool);
 		void DrawBall(CPathFinder*);
 		void DrawCurve(CPathFinder*);
@@ -0,0 +1,189 @@
+#include <algorithm>
+
+#include "./BarnesHut.hpp"
+
+void CBarnesHut::Build(const std::vector<vec3>& _points, const std::vector<float>& _radii) {
+	points = &_points;
+	radii = &_radii;
+
+	const unsigned int n = points->size();
+
+	nodes.clear();
+	order.resize(n);
+	codes.resize(n);
+	scratch.resize(n);
+
+	if (n == 0)
+		return;
+
+	vec3 mins = (*points)[0];
+	vec3 maxs = (*points)[0];
+
+	for (unsigned int i = 0; i < n; i++) {
+		order[i] = i;
+
+		mins.x = std::min(mins.x, (*points)[i].x); maxs.x = std::max(maxs.x, (*points)[i].x);
+		mins.y = std::min(mins.y, (*points)[i].y); maxs.y = std::max(maxs.y, (*points)[i].y);
+		mins.z = std::min(mins.z, (*points)[i].z); maxs.z = std::max(maxs.z, (*points)[i].z);
+	}
+
+	const vec3 ext = maxs - mins;
+	const vec3 center = (mins + maxs) * 0.5f;
+	const float halfSize = std::max(ext.x, std::max(ext.y, ext.z)) * 0.5f + EPSILON;
+
+	if (n <= BH_LEAF_SIZE) {
+		BuildNode(nodes, 0, n, center, halfSize, 0);
+		return;
+	}
+
+	// split the root here, then build its subtrees (each into
+	// a node list of its own) in parallel and append them
+	unsigned int bounds[9];
+	Partition(0, n, center, bounds);
+
+	const float h = halfSize * 0.5f;
+	const auto buildSubtree = [&](unsigned int c) {
+		const vec3 offset((c & 4)? h: -h, (c & 2)? h: -h, (c & 1)? h: -h);
+
+		subtrees[c].clear();
+
+		if (bounds[c] < bounds[c + 1]) {
+			BuildNode(subtrees[c], bounds[c], bounds[c + 1], center + offset, h, 1);
+		}
+	};
+
+	if (pool == 0x0 || n < BH_MIN_PARALLEL) {
+		for (unsigned int c = 0; c < 8; c++) {
+			buildSubtree(c);
+		}
+	} else {
+		pool->Run(8, buildSubtree);
+	}
+
+	// the root's aggregates come from its subtrees'
+	Node root;
+	root.center = center;
+	root.halfSize = halfSize;
+	root.centroid = NVec;
+	root.meanRadius = 0.0f;
+	root.count = n;
+	root.first = 0;
+	root.last = n;
+	root.leaf = false;
+
+	for (int c = 0; c < 8; c++) {
+		root.children[c] = -1;
+	}
+
+	nodes.push_back(root);
+
+	for (unsigned int c = 0; c < 8; c++) {
+		if (subtrees[c].empty())
+			continue;
+
+		const int offset = nodes.size();
+		const Node& sub = subtrees[c][0];
+
+		nodes[0].children[c] = offset;
+		nodes[0].centroid += (sub.centroid * float(sub.count));
+		nodes[0].meanRadius += (sub.meanRadius * sub.count);
+
+		for (unsigned int k = 0; k < subtrees[c].size(); k++) {
+			Node nd = subtrees[c][k];
+
+			for (int cc = 0; cc < 8; cc++) {
+				if (nd.children[cc] >= 0) {
+					nd.children[cc] += offset;
+				}
+			}
+
+			nodes.push_back(nd);
+		}
+	}
+
+	nodes[0].centroid /= float(n);
+	nodes[0].meanRadius /= n;
+}
+
+int CBarnesHut::BuildNode(std::vector<Node>& out, unsigned int first, unsigned int last, const vec3& center, float halfSize, int depth) {
+	Node nd;
+	nd.center = center;
+	nd.halfSize = halfSize;
+	nd.centroid = NVec;
+	nd.meanRadius = 0.0f;
+	nd.count = last - first;
+	nd.first = first;
+	nd.last = last;
+	nd.leaf = (nd.count <= BH_LEAF_SIZE || depth >= BH_MAX_DEPTH);
+
+	for (int c = 0; c < 8; c++) {
+		nd.children[c] = -1;
+	}
+
+	// the pair force does not depend on mass, so the
+	// centroid is the plain mean of the node's points
+	for (unsigned int a = first; a < last; a++) {
+		nd.centroid += (*points)[order[a]];
+		nd.meanRadius += (*radii)[order[a]];
+	}
+
+	if (nd.count > 0) {
+		nd.centroid /= float(nd.count);
+		nd.meanRadius /= nd.count;
+	}
+
+	const int idx = out.size();
+	out.push_back(nd);
+
+	if (nd.leaf)
+		return idx;
+
+	unsigned int bounds[9];
+	Partition(first, last, center, bounds);
+
+	const float h = halfSize * 0.5f;
+
+	for (int c = 0; c < 8; c++) {
+		if (bounds[c] == bounds[c + 1])
+			continue;
+
+		const vec3 offset((c & 4)? h: -h, (c & 2)? h: -h, (c & 1)? h: -h);
+		const int child = BuildNode(out, bounds[c], bounds[c + 1], center + offset, h, depth + 1);
+
+		// <out> may have moved, so no reference into it is kept
+		out[idx].children[c] = child;
+	}
+
+	return idx;
+}
+
+// groups order[first, last) by octant (around <center>);
+// octant c ends up in order[bounds[c], bounds[c + 1])
+void CBarnesHut::Partition(unsigned int first, unsigned int last, const vec3& center, unsigned int* bounds) {
+	unsigned int counts[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+
+	for (unsigned int a = first; a < last; a++) {
+		const vec3& p = (*points)[order[a]];
+		const unsigned int c = ((p.x > center.x) << 2) | ((p.y > center.y) << 1) | (p.z > center.z);
+
+		codes[a] = c;
+		counts[c] += 1;
+	}
+
+	bounds[0] = first;
+
+	for (int c = 0; c < 8; c++) {
+		bounds[c + 1] = bounds[c] + counts[c];
+	}
+
+	unsigned int cursors[8];
+	std::copy(bounds, bounds + 8, cursors);
+
+	// every cursor stays within [first, last), so subtrees
+	// built in parallel never touch each other's part
+	for (unsigned int a = first; a < last; a++) {
+		scratch[cursors[codes[a]]++] = order[a];
+	}
+
+	std::copy(scratch.begin() + first, scratch.begin() + last, order.begin() + first);
+}
@@ -0,0 +1,149 @@
+#ifndef BARNESHUT_HPP
+#define BARNESHUT_HPP
+
+#include <vector>
+#include <algorithm>
+
+#include "../../Math/vec3.hpp"
+#include "../../System/ThreadPool.hpp"
+
+// most points a leaf holds (unless it is BH_MAX_DEPTH deep)
+#define BH_LEAF_SIZE 8
+#define BH_MAX_DEPTH 20
+// fewer points than this are handled on the calling thread
+#define BH_MIN_PARALLEL 4096
+// points per chunk of the force sums
+#define BH_CHUNK_SIZE 512
+
+// Barnes-Hut octree over a set of points with radii: a node
+// that looks small enough from a point (size < theta * the
+// distance to its centroid) acts on it as one pseudo-point
+// of <count> times the pair force at its centroid, with the
+// node's mean radius; leaves and nodes too close to accept
+// are summed exactly, so theta == 0 gives the exact forces
+//
+// the root's eight subtrees are built (and the points'
+// forces summed) on the threads of a pool, if given one
+class CBarnesHut {
+	public:
+		CBarnesHut(): theta(0.5f), pool(0x0), points(0x0), radii(0x0) {}
+
+		void SetTheta(float t) { theta = t; }
+		// 0x0: everything runs on the calling thread
+		void SetThreadPool(CThreadPool* p) { pool = p; }
+		float GetTheta() const { return theta; }
+
+		// both vectors must stay unchanged until the forces are in
+		void Build(const std::vector<vec3>& points, const std::vector<float>& radii);
+
+		// forces[i] = sum over j != i of pairForce(points[i] -
+		// points[j], radii[i], radii[j]) (approximated as above)
+		template<typename F> void ComputeForces(std::vector<vec3>& forces, F pairForce) const;
+
+		unsigned int GetNumNodes() const { return nodes.size(); }
+
+	private:
+		struct Node {
+			vec3 center;
+			float halfSize;
+
+			vec3 centroid;
+			float meanRadius;
+			unsigned int count;
+
+			// the node's points are order[first, last)
+			unsigned int first, last;
+			int children[8];
+			bool leaf;
+		};
+
+		int BuildNode(std::vector<Node>& out, unsigned int first, unsigned int last, const vec3& center, float halfSize, int depth);
+		void Partition(unsigned int first, unsigned int last, const vec3& center, unsigned int* bounds);
+		template<typename F> vec3 ComputeForce(unsigned int i, F pairForce) const;
+
+		float theta;
+		CThreadPool* pool;
+
+		const std::vector<vec3>* points;
+		const std::vector<float>* radii;
+
+		std::vector<Node> nodes;
+		// point indices, grouped by node
+		std::vector<unsigned int> order;
+		// octant codes and reordering space for Partition
+		std::vector<unsigned char> codes;
+		std::vector<unsigned int> scratch;
+		// the root's subtrees, built separately
+		std::vector<Node> subtrees[8];
+};
+
+template<typename F> void CBarnesHut::ComputeForces(std::vector<vec3>& forces, F pairForce) const {
+	const unsigned int n = order.size();
+
+	// in tree order, so consecutive points walk similar paths
+	const auto sumRange = [&](unsigned int a0, unsigned int a1) {
+		for (unsigned int a = a0; a < a1; a++) {
+			forces[order[a]] = ComputeForce(order[a], pairForce);
+		}
+	};
+
+	if (pool == 0x0 || n < BH_MIN_PARALLEL) {
+		sumRange(0, n);
+	} else {
+		pool->Run((n + BH_CHUNK_SIZE - 1) / BH_CHUNK_SIZE, [&](unsigned int c) {
+			sumRange(c * BH_CHUNK_SIZE, std::min((c + 1) * BH_CHUNK_SIZE, n));
+		});
+	}
+}
+
+template<typename F> vec3 CBarnesHut::ComputeForce(unsigned int i, F pairForce) const {
+	const vec3& p = (*points)[i];
+	const float r = (*radii)[i];
+	const float thetaSq = theta * theta;
+
+	vec3 force = NVec;
+
+	// BH_MAX_DEPTH levels of at most 8 children each
+	int stack[8 * (BH_MAX_DEPTH + 1)];
+	int top = 0;
+
+	if (!nodes.empty()) {
+		stack[top++] = 0;
+	}
+
+	while (top > 0) {
+		const Node& nd = nodes[stack[--top]];
+
+		if (nd.leaf) {
+			for (unsigned int a = nd.first; a < nd.last; a++) {
+				const unsigned int j = order[a];
+
+				if (j != i) {
+					force += pairForce(p - (*points)[j], r, (*radii)[j]);
+				}
+			}
+
+			continue;
+		}
+
+		const vec3 d = p - nd.centroid;
+		const vec3 o = (p - nd.center).abs();
+		const float size = nd.halfSize * 2.0f;
+		const bool inside = (o.x <= nd.halfSize && o.y <= nd.halfSize && o.z <= nd.halfSize);
+
+		if (!inside && (size * size) < (thetaSq * d.sqLen3D())) {
+			force += (pairForce(d, r, nd.meanRadius) * float(nd.count));
+			continue;
+		}
+
+		for (int c = 0; c < 8; c++) {
+			if (nd.children[c] >= 0) {
+				stack[top++] = nd.children[c];
+			}
+		}
+	}
+
+	return force;
+}
+
+#endif
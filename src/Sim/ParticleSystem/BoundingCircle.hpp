@@ -17,6 +17,7 @@ struct BoundingCircle {
 		radius = rad;
 		segmentAngle = 360.0f / numSegments;
 
+		vertices.reserve(numSegments);
 		segmentNormals.resize(numSegments);
 		segmentDirects.resize(numSegments);
 
@@ -50,7 +51,7 @@ struct BoundingCircle {
 	//
 	// pass in the particle's pos after multiplying
 	// by the slice's inverse transformation matrix
-	float GetAngle(float x, float y) const {
+	static float GetAngle(float x, float y) {
 		float a = RTOD(atan2(y, x));
 		float r = 0.0f;
 
@@ -91,13 +92,7 @@ struct BoundingCircle {
 		} else {
 			const float a = GetAngle(invPos.x, invPos.y);
 			const int seg = GetSegmentIndex(a);
-
-			// get the world-space normal vector of this segment
-			const vec3& v1 = vertices[(seg    )                  ];
-			const vec3& v2 = vertices[(seg + 1) % vertices.size()];
-			const vec3  v3 = (v1 + v2) * 0.5f;
-			const vec3  v4 = v3 + segmentNormals[seg];
-			const vec3  nv  = m.Mul(v4) - m.Mul(v3);
+			const vec3 nv = GetWorldSegmentNormal(seg);
 
 			// get orthogonal distance to segment edge
 			// defined by vertices <s> and <s + 1>
@@ -108,6 +103,15 @@ struct BoundingCircle {
 		}
 	}
 
+	// the normal of segment <seg> in world-space
+	vec3 GetWorldSegmentNormal(int seg) const {
+		const vec3& v1 = vertices[(seg    )                  ];
+		const vec3& v2 = vertices[(seg + 1) % vertices.size()];
+		const vec3  v3 = (v1 + v2) * 0.5f;
+		const vec3  v4 = v3 + segmentNormals[seg];
+		return (m.Mul(v4) - m.Mul(v3));
+	}
+
 	matrix44 GetTransformMatrix(const vec3& pos, const vec3& nor) {
 		// transform a tunnel slice at world-coors <pos>
 		// and with world-coors normal <nor> to XY-plane
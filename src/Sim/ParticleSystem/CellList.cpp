@@ -0,0 +1,74 @@
+#include <cmath>
+#include <algorithm>
+
+#include "./CellList.hpp"
+
+void CCellList::Build(const std::vector<vec3>& points, float cutoff) {
+	const unsigned int n = points.size();
+
+	vec3 maxs;
+	mins = maxs = (n > 0)? points[0]: NVec;
+
+	for (unsigned int i = 1; i < n; i++) {
+		mins.x = std::min(mins.x, points[i].x); maxs.x = std::max(maxs.x, points[i].x);
+		mins.y = std::min(mins.y, points[i].y); maxs.y = std::max(maxs.y, points[i].y);
+		mins.z = std::min(mins.z, points[i].z); maxs.z = std::max(maxs.z, points[i].z);
+	}
+
+	// a sparse cloud (eg. spread along a long tunnel) would
+	// otherwise need far more (mostly empty) cells than points
+	const double maxCells = double(std::max(n, 1u)) * CELLLIST_CELLS_PER_POINT;
+	const vec3 ext = maxs - mins;
+
+	cellSize = cutoff;
+
+	while (true) {
+		numX = int(ext.x / cellSize) + 1;
+		numY = int(ext.y / cellSize) + 1;
+		numZ = int(ext.z / cellSize) + 1;
+
+		if ((double(numX) * numY * numZ) <= maxCells)
+			break;
+
+		cellSize *= 1.25f;
+	}
+
+	const unsigned int numCells = numX * numY * numZ;
+	const float invCellSize = 1.0f / cellSize;
+
+	cells.resize(n);
+	sorted.resize(n);
+	sortedPoints.resize(n);
+	cellStarts.assign(numCells + 1, 0);
+
+	// counting sort: histogram, prefix sums, scatter
+	for (unsigned int i = 0; i < n; i++) {
+		const vec3 d = (points[i] - mins) * invCellSize;
+		const int cx = std::min(int(d.x), numX - 1);
+		const int cy = std::min(int(d.y), numY - 1);
+		const int cz = std::min(int(d.z), numZ - 1);
+
+		cells[i] = (cx * numY + cy) * numZ + cz;
+		cellStarts[cells[i] + 1] += 1;
+	}
+
+	for (unsigned int c = 0; c < numCells; c++) {
+		cellStarts[c + 1] += cellStarts[c];
+	}
+
+	// shifted up by one, cellStarts[c + 1] is the write cursor
+	// of cell c; scattering moves it to the end of c, which is
+	// where c + 1 starts
+	for (unsigned int c = numCells; c > 0; c--) {
+		cellStarts[c] = cellStarts[c - 1];
+	}
+
+	cellStarts[0] = 0;
+
+	for (unsigned int i = 0; i < n; i++) {
+		const unsigned int a = cellStarts[cells[i] + 1]++;
+
+		sorted[a] = i;
+		sortedPoints[a] = points[i];
+	}
+}
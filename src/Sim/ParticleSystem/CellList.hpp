@@ -0,0 +1,119 @@
+#ifndef CELLLIST_HPP
+#define CELLLIST_HPP
+
+#include <vector>
+#include <algorithm>
+
+#include "../../Math/vec3.hpp"
+
+// uniform grid over the bounding box of a set of points with
+// cells of (at least) some interaction cutoff, so every point
+// within the cutoff of another lies in one of the 27 cells
+// around it; rebuilt from scratch by a counting sort
+class CCellList {
+	public:
+		CCellList(): cellSize(0.0f), numX(0), numY(0), numZ(0), cellStarts(1, 0) {}
+
+		// cells grow beyond <cutoff> when the box would need more
+		// than about CELLLIST_CELLS_PER_POINT cells per point
+		void Build(const std::vector<vec3>& points, float cutoff);
+
+		// calls f(i, j, d) with d = points[i] - points[j] for every
+		// ordered pair (i != j) of points in neighbouring cells, one
+		// cell of i's at a time (pairs can be further than cutoff)
+		template<typename F> void ForEachCandidatePair(F f) const;
+		// calls f(a, b, d) once for every unordered pair as above,
+		// with a < b their positions in cell order (see GetPoint)
+		// and only for the pairs with a in [a0, a1), so splitting
+		// [0, GetNumPoints()) splits the pairs between callers
+		template<typename F> void ForEachUniquePair(unsigned int a0, unsigned int a1, F f) const;
+		// every b the pairs of [a0, a1) reach lies in [a0, this)
+		unsigned int GetPairRangeEnd(unsigned int a0, unsigned int a1) const;
+
+		// index of the point at position <a> in cell order
+		unsigned int GetPoint(unsigned int a) const { return sorted[a]; }
+		unsigned int GetNumPoints() const { return sorted.size(); }
+		unsigned int GetNumCells() const { return (cellStarts.size() - 1); }
+		float GetCellSize() const { return cellSize; }
+
+	private:
+		vec3 mins;
+		float cellSize;
+		int numX, numY, numZ;
+
+		// cell of every point, points grouped by cell (and
+		// their positions, in the same order) and the offset
+		// of every cell's first point into <sorted>
+		std::vector<unsigned int> cells;
+		std::vector<unsigned int> sorted;
+		std::vector<vec3> sortedPoints;
+		std::vector<unsigned int> cellStarts;
+};
+
+#define CELLLIST_CELLS_PER_POINT 4
+
+template<typename F> void CCellList::ForEachCandidatePair(F f) const {
+	for (int cx = 0; cx < numX; cx++) {
+		for (int cy = 0; cy < numY; cy++) {
+			for (int cz = 0; cz < numZ; cz++) {
+				const unsigned int c = (cx * numY + cy) * numZ + cz;
+
+				for (unsigned int a = cellStarts[c]; a < cellStarts[c + 1]; a++) {
+					const unsigned int i = sorted[a];
+					const vec3& pi = sortedPoints[a];
+
+					for (int nx = std::max(cx - 1, 0); nx <= std::min(cx + 1, numX - 1); nx++) {
+						for (int ny = std::max(cy - 1, 0); ny <= std::min(cy + 1, numY - 1); ny++) {
+							// cells along z are contiguous, so are their points
+							const unsigned int n0 = (nx * numY + ny) * numZ + std::max(cz - 1, 0);
+							const unsigned int n1 = (nx * numY + ny) * numZ + std::min(cz + 1, numZ - 1);
+
+							for (unsigned int b = cellStarts[n0]; b < cellStarts[n1 + 1]; b++) {
+								if (b == a)
+									continue;
+
+								f(a, b, pi - sortedPoints[b]);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+template<typename F> void CCellList::ForEachUniquePair(unsigned int a0, unsigned int a1, F f) const {
+	for (unsigned int a = a0; a < a1; a++) {
+		const unsigned int c = cells[sorted[a]];
+		const int cx = c / (numY * numZ);
+		const int cy = (c / numZ) % numY;
+		const int cz = c % numZ;
+		const vec3& pi = sortedPoints[a];
+
+		for (int nx = std::max(cx - 1, 0); nx <= std::min(cx + 1, numX - 1); nx++) {
+			for (int ny = std::max(cy - 1, 0); ny <= std::min(cy + 1, numY - 1); ny++) {
+				const unsigned int n0 = (nx * numY + ny) * numZ + std::max(cz - 1, 0);
+				const unsigned int n1 = (nx * numY + ny) * numZ + std::min(cz + 1, numZ - 1);
+
+				// the neighbourhood is symmetric, so (a, b) and (b, a)
+				// both come up; only the one with a < b is kept
+				for (unsigned int b = std::max(cellStarts[n0], a + 1); b < cellStarts[n1 + 1]; b++) {
+					f(a, b, pi - sortedPoints[b]);
+				}
+			}
+		}
+	}
+}
+
+inline unsigned int CCellList::GetPairRangeEnd(unsigned int a0, unsigned int a1) const {
+	if (a0 >= a1)
+		return a0;
+
+	// the last point's cell has the highest neighbour of all
+	const unsigned int c = cells[sorted[a1 - 1]];
+	const unsigned int n = std::min(c + (numY * numZ) + numZ + 1, GetNumCells() - 1);
+
+	return std::max(cellStarts[n + 1], a1);
+}
+
+#endif
@@ -0,0 +1,671 @@
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__))
+	#define PAIR_KERNEL_X86 1
+	#include <immintrin.h>
+#else
+	#define PAIR_KERNEL_X86 0
+#endif
+
+#include "./PairKernel.hpp"
+
+// 2^f on [-0.5, 0.5] is 1 + f * P(f), ln(1 + x) on
+// [sqrt(0.5) - 1, sqrt(2) - 1] is x - x^2 / 2 + x^3 * Q(x)
+#define EXP2_P0  1.535336188319500e-4f
+#define EXP2_P1  1.339887440266574e-3f
+#define EXP2_P2  9.618437357674640e-3f
+#define EXP2_P3  5.550332471162809e-2f
+#define EXP2_P4  2.402264791363012e-1f
+#define EXP2_P5  6.931472028550421e-1f
+#define LN_Q0    7.0376836292e-2f
+#define LN_Q1   -1.1514610310e-1f
+#define LN_Q2    1.1676998740e-1f
+#define LN_Q3   -1.2420140846e-1f
+#define LN_Q4    1.4249322787e-1f
+#define LN_Q5   -1.6668057665e-1f
+#define LN_Q6    2.0000714765e-1f
+#define LN_Q7   -2.4999993993e-1f
+#define LN_Q8    3.3333331174e-1f
+// ln(2) split in two, the first part exact in a float
+#define LN2_HI   0.693359375f
+#define LN2_LO  -2.12194440e-4f
+#define LOG2E    1.44269504089f
+
+// same arithmetic as CParticleSystem's PairForce
+static inline vec3 PairForceScalar(const PairForceParams& p, const vec3& d, float ri, float rj) {
+	const float r = d.len3D();
+
+	float z = r - ri - rj;
+	z = (z < p.minDist)? p.minDist: z;
+
+	const float d1 = powf(z, p.s1);
+	const float d2 = powf(z, p.s2);
+	const float s  = (p.c1 / d1) + (p.c2 / d2);
+
+	return ((d / r) * s);
+}
+
+static void AddForcesScalar(const PairForceParams& p, const float* px, const float* py, const float* pz, const float* radius, unsigned int n, unsigned int i, vec3& force) {
+	const vec3 pi(px[i], py[i], pz[i]);
+	const float ri = radius[i];
+
+	// <force> could alias the arrays as far as the compiler
+	// knows, summing into it directly keeps it in memory
+	vec3 sum = force;
+
+	for (unsigned int j = 0; j < n; j++) {
+		if (j == i) continue;
+
+		sum += PairForceScalar(p, pi - vec3(px[j], py[j], pz[j]), ri, radius[j]);
+	}
+
+	force = sum;
+}
+
+static void AddPairForcesScalar(const PairForceParams& p, const float* px, const float* py, const float* pz, const float* radius, unsigned int n, unsigned int i, float* fx, float* fy, float* fz) {
+	const vec3 pi(px[i], py[i], pz[i]);
+	const float ri = radius[i];
+
+	vec3 sum;
+
+	for (unsigned int j = i + 1; j < n; j++) {
+		const vec3 f = PairForceScalar(p, pi - vec3(px[j], py[j], pz[j]), ri, radius[j]);
+
+		sum += f;
+		fx[j] -= f.x;
+		fy[j] -= f.y;
+		fz[j] -= f.z;
+	}
+
+	fx[i] += sum.x;
+	fy[i] += sum.y;
+	fz[i] += sum.z;
+}
+
+static void PowScalar(const float* z, float s, float* out, unsigned int n) {
+	for (unsigned int k = 0; k < n; k++) {
+		out[k] = 1.0f / powf(z[k], s);
+	}
+}
+
+
+
+#if (PAIR_KERNEL_X86 == 1)
+static inline __m128 Exp2SSE2(__m128 t) {
+	t = _mm_min_ps(_mm_max_ps(t, _mm_set1_ps(-126.0f)), _mm_set1_ps(126.0f));
+
+	const __m128i n = _mm_cvtps_epi32(t);
+	const __m128 f = _mm_sub_ps(t, _mm_cvtepi32_ps(n));
+
+	__m128 q = _mm_set1_ps(EXP2_P0);
+	q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(EXP2_P1));
+	q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(EXP2_P2));
+	q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(EXP2_P3));
+	q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(EXP2_P4));
+	q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(EXP2_P5));
+	q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(1.0f));
+
+	return _mm_mul_ps(q, _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23)));
+}
+
+// z must be positive and normal
+static inline __m128 LnSSE2(__m128 z) {
+	const __m128i zi = _mm_castps_si128(z);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	__m128i e = _mm_sub_epi32(_mm_srli_epi32(zi, 23), _mm_set1_epi32(127));
+	__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(zi, _mm_set1_epi32(0x007fffff)), _mm_castps_si128(one)));
+
+	// move the mantissa from [1, 2) to [sqrt(0.5), sqrt(2))
+	const __m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(SQRT2));
+	m = _mm_or_ps(_mm_andnot_ps(big, m), _mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(0.5f))));
+	e = _mm_sub_epi32(e, _mm_castps_si128(big));
+
+	const __m128 ef = _mm_cvtepi32_ps(e);
+	const __m128 x = _mm_sub_ps(m, one);
+	const __m128 x2 = _mm_mul_ps(x, x);
+
+	__m128 q = _mm_set1_ps(LN_Q0);
+	q = _mm_add_ps(_mm_mul_ps(q, x), _mm_set1_ps(LN_Q1));
+	q = _mm_add_ps(_mm_mul_ps(q, x), _mm_set1_ps(LN_Q2));
+	q = _mm_add_ps(_mm_mul_ps(q, x), _mm_set1_ps(LN_Q3));
+	q = _mm_add_ps(_mm_mul_ps(q, x), _mm_set1_ps(LN_Q4));
+	q = _mm_add_ps(_mm_mul_ps(q, x), _mm_set1_ps(LN_Q5));
+	q = _mm_add_ps(_mm_mul_ps(q, x), _mm_set1_ps(LN_Q6));
+	q = _mm_add_ps(_mm_mul_ps(q, x), _mm_set1_ps(LN_Q7));
+	q = _mm_add_ps(_mm_mul_ps(q, x), _mm_set1_ps(LN_Q8));
+
+	__m128 y = _mm_mul_ps(_mm_mul_ps(q, x), x2);
+	y = _mm_add_ps(y, _mm_mul_ps(ef, _mm_set1_ps(LN2_LO)));
+	y = _mm_sub_ps(y, _mm_mul_ps(x2, _mm_set1_ps(0.5f)));
+
+	return _mm_add_ps(_mm_add_ps(x, y), _mm_mul_ps(ef, _mm_set1_ps(LN2_HI)));
+}
+
+// (c1 / z^s1 + c2 / z^s2) / r for pairs of radii ri and rj
+// whose centers are r apart
+static inline __m128 ForceScaleSSE2(const PairForceParams& p, __m128 r, __m128 ri, __m128 rj) {
+	const __m128 z = _mm_max_ps(_mm_sub_ps(_mm_sub_ps(r, ri), rj), _mm_set1_ps(p.minDist));
+	const __m128 lnz = LnSSE2(z);
+	const __m128 t1 = _mm_mul_ps(_mm_set1_ps(-p.s1 * LOG2E), lnz);
+	const __m128 t2 = _mm_mul_ps(_mm_set1_ps(-p.s2 * LOG2E), lnz);
+	const __m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.c1), Exp2SSE2(t1)), _mm_mul_ps(_mm_set1_ps(p.c2), Exp2SSE2(t2)));
+
+	return _mm_div_ps(s, r);
+}
+
+static inline vec3 SumSSE2(__m128 fx, __m128 fy, __m128 fz) {
+	float sx[4], sy[4], sz[4];
+	_mm_storeu_ps(sx, fx);
+	_mm_storeu_ps(sy, fy);
+	_mm_storeu_ps(sz, fz);
+
+	return vec3(sx[0] + sx[1] + sx[2] + sx[3], sy[0] + sy[1] + sy[2] + sy[3], sz[0] + sz[1] + sz[2] + sz[3]);
+}
+
+static void AddForcesSSE2(const PairForceParams& _p, const float* px, const float* py, const float* pz, const float* radius, unsigned int n, unsigned int i, vec3& force) {
+	const PairForceParams p = _p;
+	const __m128 xi = _mm_set1_ps(px[i]);
+	const __m128 yi = _mm_set1_ps(py[i]);
+	const __m128 zi = _mm_set1_ps(pz[i]);
+	const __m128 ri = _mm_set1_ps(radius[i]);
+	const __m128i nv = _mm_set1_epi32(n);
+	const __m128i iv = _mm_set1_epi32(i);
+
+	__m128i idx = _mm_setr_epi32(0, 1, 2, 3);
+	__m128 fx = _mm_setzero_ps();
+	__m128 fy = _mm_setzero_ps();
+	__m128 fz = _mm_setzero_ps();
+
+	for (unsigned int j = 0; j < n; j += 4) {
+		const __m128 dx = _mm_sub_ps(xi, _mm_loadu_ps(px + j));
+		const __m128 dy = _mm_sub_ps(yi, _mm_loadu_ps(py + j));
+		const __m128 dz = _mm_sub_ps(zi, _mm_loadu_ps(pz + j));
+		const __m128 r = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+
+		// lanes past n and lane i (r = 0) drop out
+		const __m128i valid = _mm_andnot_si128(_mm_cmpeq_epi32(idx, iv), _mm_cmplt_epi32(idx, nv));
+		const __m128 k = _mm_and_ps(ForceScaleSSE2(p, r, ri, _mm_loadu_ps(radius + j)), _mm_castsi128_ps(valid));
+
+		fx = _mm_add_ps(fx, _mm_mul_ps(dx, k));
+		fy = _mm_add_ps(fy, _mm_mul_ps(dy, k));
+		fz = _mm_add_ps(fz, _mm_mul_ps(dz, k));
+		idx = _mm_add_epi32(idx, _mm_set1_epi32(4));
+	}
+
+	force += SumSSE2(fx, fy, fz);
+}
+
+static void AddPairForcesSSE2(const PairForceParams& _p, const float* px, const float* py, const float* pz, const float* radius, unsigned int n, unsigned int i, float* fxs, float* fys, float* fzs) {
+	const PairForceParams p = _p;
+	const __m128 xi = _mm_set1_ps(px[i]);
+	const __m128 yi = _mm_set1_ps(py[i]);
+	const __m128 zi = _mm_set1_ps(pz[i]);
+	const __m128 ri = _mm_set1_ps(radius[i]);
+	const __m128i nv = _mm_set1_epi32(n);
+	const __m128i iv = _mm_set1_epi32(i);
+
+	// from the step holding i + 1, the lanes up to i drop out
+	const unsigned int j0 = (i + 1) & ~3u;
+
+	__m128i idx = _mm_add_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(j0));
+	__m128 fx = _mm_setzero_ps();
+	__m128 fy = _mm_setzero_ps();
+	__m128 fz = _mm_setzero_ps();
+
+	for (unsigned int j = j0; j < n; j += 4) {
+		const __m128 dx = _mm_sub_ps(xi, _mm_loadu_ps(px + j));
+		const __m128 dy = _mm_sub_ps(yi, _mm_loadu_ps(py + j));
+		const __m128 dz = _mm_sub_ps(zi, _mm_loadu_ps(pz + j));
+		const __m128 r = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+
+		const __m128i valid = _mm_and_si128(_mm_cmpgt_epi32(idx, iv), _mm_cmplt_epi32(idx, nv));
+		const __m128 k = _mm_and_ps(ForceScaleSSE2(p, r, ri, _mm_loadu_ps(radius + j)), _mm_castsi128_ps(valid));
+		const __m128 kx = _mm_mul_ps(dx, k);
+		const __m128 ky = _mm_mul_ps(dy, k);
+		const __m128 kz = _mm_mul_ps(dz, k);
+
+		// the dropped lanes subtract 0
+		fx = _mm_add_ps(fx, kx); _mm_storeu_ps(fxs + j, _mm_sub_ps(_mm_loadu_ps(fxs + j), kx));
+		fy = _mm_add_ps(fy, ky); _mm_storeu_ps(fys + j, _mm_sub_ps(_mm_loadu_ps(fys + j), ky));
+		fz = _mm_add_ps(fz, kz); _mm_storeu_ps(fzs + j, _mm_sub_ps(_mm_loadu_ps(fzs + j), kz));
+		idx = _mm_add_epi32(idx, _mm_set1_epi32(4));
+	}
+
+	const vec3 sum = SumSSE2(fx, fy, fz);
+
+	fxs[i] += sum.x;
+	fys[i] += sum.y;
+	fzs[i] += sum.z;
+}
+
+static void PowSSE2(const float* z, float s, float* out, unsigned int n) {
+	for (unsigned int k = 0; k < n; k += 4) {
+		_mm_storeu_ps(out + k, Exp2SSE2(_mm_mul_ps(_mm_set1_ps(-s * LOG2E), LnSSE2(_mm_loadu_ps(z + k)))));
+	}
+}
+
+
+
+__attribute__((target("avx2,fma")))
+static inline __m256 Exp2AVX2(__m256 t) {
+	t = _mm256_min_ps(_mm256_max_ps(t, _mm256_set1_ps(-126.0f)), _mm256_set1_ps(126.0f));
+
+	const __m256 nf = _mm256_round_ps(t, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	const __m256 f = _mm256_sub_ps(t, nf);
+
+	__m256 q = _mm256_set1_ps(EXP2_P0);
+	q = _mm256_fmadd_ps(q, f, _mm256_set1_ps(EXP2_P1));
+	q = _mm256_fmadd_ps(q, f, _mm256_set1_ps(EXP2_P2));
+	q = _mm256_fmadd_ps(q, f, _mm256_set1_ps(EXP2_P3));
+	q = _mm256_fmadd_ps(q, f, _mm256_set1_ps(EXP2_P4));
+	q = _mm256_fmadd_ps(q, f, _mm256_set1_ps(EXP2_P5));
+	q = _mm256_fmadd_ps(q, f, _mm256_set1_ps(1.0f));
+
+	const __m256i n = _mm256_cvtps_epi32(nf);
+	return _mm256_mul_ps(q, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23)));
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 LnAVX2(__m256 z) {
+	const __m256i zi = _mm256_castps_si256(z);
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	__m256i e = _mm256_sub_epi32(_mm256_srli_epi32(zi, 23), _mm256_set1_epi32(127));
+	__m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(zi, _mm256_set1_epi32(0x007fffff)), _mm256_castps_si256(one)));
+
+	const __m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(SQRT2), _CMP_GT_OQ);
+	m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big);
+	e = _mm256_sub_epi32(e, _mm256_castps_si256(big));
+
+	const __m256 ef = _mm256_cvtepi32_ps(e);
+	const __m256 x = _mm256_sub_ps(m, one);
+	const __m256 x2 = _mm256_mul_ps(x, x);
+
+	__m256 q = _mm256_set1_ps(LN_Q0);
+	q = _mm256_fmadd_ps(q, x, _mm256_set1_ps(LN_Q1));
+	q = _mm256_fmadd_ps(q, x, _mm256_set1_ps(LN_Q2));
+	q = _mm256_fmadd_ps(q, x, _mm256_set1_ps(LN_Q3));
+	q = _mm256_fmadd_ps(q, x, _mm256_set1_ps(LN_Q4));
+	q = _mm256_fmadd_ps(q, x, _mm256_set1_ps(LN_Q5));
+	q = _mm256_fmadd_ps(q, x, _mm256_set1_ps(LN_Q6));
+	q = _mm256_fmadd_ps(q, x, _mm256_set1_ps(LN_Q7));
+	q = _mm256_fmadd_ps(q, x, _mm256_set1_ps(LN_Q8));
+
+	__m256 y = _mm256_mul_ps(_mm256_mul_ps(q, x), x2);
+	y = _mm256_fmadd_ps(ef, _mm256_set1_ps(LN2_LO), y);
+	y = _mm256_fnmadd_ps(x2, _mm256_set1_ps(0.5f), y);
+
+	return _mm256_fmadd_ps(ef, _mm256_set1_ps(LN2_HI), _mm256_add_ps(x, y));
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 ForceScaleAVX2(const PairForceParams& p, __m256 r, __m256 ri, __m256 rj) {
+	const __m256 z = _mm256_max_ps(_mm256_sub_ps(_mm256_sub_ps(r, ri), rj), _mm256_set1_ps(p.minDist));
+	const __m256 lnz = LnAVX2(z);
+	const __m256 t1 = _mm256_mul_ps(_mm256_set1_ps(-p.s1 * LOG2E), lnz);
+	const __m256 t2 = _mm256_mul_ps(_mm256_set1_ps(-p.s2 * LOG2E), lnz);
+	const __m256 s = _mm256_fmadd_ps(_mm256_set1_ps(p.c1), Exp2AVX2(t1), _mm256_mul_ps(_mm256_set1_ps(p.c2), Exp2AVX2(t2)));
+
+	return _mm256_div_ps(s, r);
+}
+
+__attribute__((target("avx2,fma")))
+static inline vec3 SumAVX2(__m256 fx, __m256 fy, __m256 fz) {
+	float sx[8], sy[8], sz[8];
+	_mm256_storeu_ps(sx, fx);
+	_mm256_storeu_ps(sy, fy);
+	_mm256_storeu_ps(sz, fz);
+
+	vec3 sum;
+
+	for (int k = 0; k < 8; k++) {
+		sum += vec3(sx[k], sy[k], sz[k]);
+	}
+
+	return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static void AddForcesAVX2(const PairForceParams& _p, const float* px, const float* py, const float* pz, const float* radius, unsigned int n, unsigned int i, vec3& force) {
+	const PairForceParams p = _p;
+	const __m256 xi = _mm256_set1_ps(px[i]);
+	const __m256 yi = _mm256_set1_ps(py[i]);
+	const __m256 zi = _mm256_set1_ps(pz[i]);
+	const __m256 ri = _mm256_set1_ps(radius[i]);
+	const __m256i nv = _mm256_set1_epi32(n);
+	const __m256i iv = _mm256_set1_epi32(i);
+
+	__m256i idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256 fx = _mm256_setzero_ps();
+	__m256 fy = _mm256_setzero_ps();
+	__m256 fz = _mm256_setzero_ps();
+
+	for (unsigned int j = 0; j < n; j += 8) {
+		const __m256 dx = _mm256_sub_ps(xi, _mm256_loadu_ps(px + j));
+		const __m256 dy = _mm256_sub_ps(yi, _mm256_loadu_ps(py + j));
+		const __m256 dz = _mm256_sub_ps(zi, _mm256_loadu_ps(pz + j));
+		const __m256 r = _mm256_sqrt_ps(_mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz))));
+
+		const __m256i valid = _mm256_andnot_si256(_mm256_cmpeq_epi32(idx, iv), _mm256_cmpgt_epi32(nv, idx));
+		const __m256 k = _mm256_and_ps(ForceScaleAVX2(p, r, ri, _mm256_loadu_ps(radius + j)), _mm256_castsi256_ps(valid));
+
+		fx = _mm256_fmadd_ps(dx, k, fx);
+		fy = _mm256_fmadd_ps(dy, k, fy);
+		fz = _mm256_fmadd_ps(dz, k, fz);
+		idx = _mm256_add_epi32(idx, _mm256_set1_epi32(8));
+	}
+
+	force += SumAVX2(fx, fy, fz);
+}
+
+__attribute__((target("avx2,fma")))
+static void AddPairForcesAVX2(const PairForceParams& _p, const float* px, const float* py, const float* pz, const float* radius, unsigned int n, unsigned int i, float* fxs, float* fys, float* fzs) {
+	const PairForceParams p = _p;
+	const __m256 xi = _mm256_set1_ps(px[i]);
+	const __m256 yi = _mm256_set1_ps(py[i]);
+	const __m256 zi = _mm256_set1_ps(pz[i]);
+	const __m256 ri = _mm256_set1_ps(radius[i]);
+	const __m256i nv = _mm256_set1_epi32(n);
+	const __m256i iv = _mm256_set1_epi32(i);
+	const unsigned int j0 = (i + 1) & ~7u;
+
+	__m256i idx = _mm256_add_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(j0));
+	__m256 fx = _mm256_setzero_ps();
+	__m256 fy = _mm256_setzero_ps();
+	__m256 fz = _mm256_setzero_ps();
+
+	for (unsigned int j = j0; j < n; j += 8) {
+		const __m256 dx = _mm256_sub_ps(xi, _mm256_loadu_ps(px + j));
+		const __m256 dy = _mm256_sub_ps(yi, _mm256_loadu_ps(py + j));
+		const __m256 dz = _mm256_sub_ps(zi, _mm256_loadu_ps(pz + j));
+		const __m256 r = _mm256_sqrt_ps(_mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz))));
+
+		const __m256i valid = _mm256_and_si256(_mm256_cmpgt_epi32(idx, iv), _mm256_cmpgt_epi32(nv, idx));
+		const __m256 k = _mm256_and_ps(ForceScaleAVX2(p, r, ri, _mm256_loadu_ps(radius + j)), _mm256_castsi256_ps(valid));
+
+		fx = _mm256_fmadd_ps(dx, k, fx); _mm256_storeu_ps(fxs + j, _mm256_fnmadd_ps(dx, k, _mm256_loadu_ps(fxs + j)));
+		fy = _mm256_fmadd_ps(dy, k, fy); _mm256_storeu_ps(fys + j, _mm256_fnmadd_ps(dy, k, _mm256_loadu_ps(fys + j)));
+		fz = _mm256_fmadd_ps(dz, k, fz); _mm256_storeu_ps(fzs + j, _mm256_fnmadd_ps(dz, k, _mm256_loadu_ps(fzs + j)));
+		idx = _mm256_add_epi32(idx, _mm256_set1_epi32(8));
+	}
+
+	const vec3 sum = SumAVX2(fx, fy, fz);
+
+	fxs[i] += sum.x;
+	fys[i] += sum.y;
+	fzs[i] += sum.z;
+}
+
+__attribute__((target("avx2,fma")))
+static void PowAVX2(const float* z, float s, float* out, unsigned int n) {
+	for (unsigned int k = 0; k < n; k += 8) {
+		_mm256_storeu_ps(out + k, Exp2AVX2(_mm256_mul_ps(_mm256_set1_ps(-s * LOG2E), LnAVX2(_mm256_loadu_ps(z + k)))));
+	}
+}
+
+
+
+// GCC 12's unmasked AVX-512 intrinsics pass an undefined
+// register through the masked builtins, which -Wall reports
+// as uninitialized once inlined; the zero-masking forms over
+// all lanes are the same instructions without that
+#define AVX512_ALL ((__mmask16) 0xFFFF)
+
+__attribute__((target("avx512f")))
+static inline __m512 Exp2AVX512(__m512 t) {
+	t = _mm512_maskz_min_ps(AVX512_ALL, _mm512_maskz_max_ps(AVX512_ALL, t, _mm512_set1_ps(-126.0f)), _mm512_set1_ps(126.0f));
+
+	const __m512 nf = _mm512_maskz_roundscale_ps(AVX512_ALL, t, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	const __m512 f = _mm512_sub_ps(t, nf);
+
+	__m512 q = _mm512_set1_ps(EXP2_P0);
+	q = _mm512_fmadd_ps(q, f, _mm512_set1_ps(EXP2_P1));
+	q = _mm512_fmadd_ps(q, f, _mm512_set1_ps(EXP2_P2));
+	q = _mm512_fmadd_ps(q, f, _mm512_set1_ps(EXP2_P3));
+	q = _mm512_fmadd_ps(q, f, _mm512_set1_ps(EXP2_P4));
+	q = _mm512_fmadd_ps(q, f, _mm512_set1_ps(EXP2_P5));
+	q = _mm512_fmadd_ps(q, f, _mm512_set1_ps(1.0f));
+
+	// q * 2^nf without going through the integer unit
+	return _mm512_maskz_scalef_ps(AVX512_ALL, q, nf);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 LnAVX512(__m512 z) {
+	const __m512i zi = _mm512_castps_si512(z);
+	const __m512 one = _mm512_set1_ps(1.0f);
+
+	__m512i e = _mm512_sub_epi32(_mm512_maskz_srli_epi32(AVX512_ALL, zi, 23), _mm512_set1_epi32(127));
+	__m512 m = _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(zi, _mm512_set1_epi32(0x007fffff)), _mm512_castps_si512(one)));
+
+	const __mmask16 big = _mm512_cmp_ps_mask(m, _mm512_set1_ps(SQRT2), _CMP_GT_OQ);
+	m = _mm512_mask_mul_ps(m, big, m, _mm512_set1_ps(0.5f));
+	e = _mm512_mask_add_epi32(e, big, e, _mm512_set1_epi32(1));
+
+	const __m512 ef = _mm512_maskz_cvtepi32_ps(AVX512_ALL, e);
+	const __m512 x = _mm512_sub_ps(m, one);
+	const __m512 x2 = _mm512_mul_ps(x, x);
+
+	__m512 q = _mm512_set1_ps(LN_Q0);
+	q = _mm512_fmadd_ps(q, x, _mm512_set1_ps(LN_Q1));
+	q = _mm512_fmadd_ps(q, x, _mm512_set1_ps(LN_Q2));
+	q = _mm512_fmadd_ps(q, x, _mm512_set1_ps(LN_Q3));
+	q = _mm512_fmadd_ps(q, x, _mm512_set1_ps(LN_Q4));
+	q = _mm512_fmadd_ps(q, x, _mm512_set1_ps(LN_Q5));
+	q = _mm512_fmadd_ps(q, x, _mm512_set1_ps(LN_Q6));
+	q = _mm512_fmadd_ps(q, x, _mm512_set1_ps(LN_Q7));
+	q = _mm512_fmadd_ps(q, x, _mm512_set1_ps(LN_Q8));
+
+	__m512 y = _mm512_mul_ps(_mm512_mul_ps(q, x), x2);
+	y = _mm512_fmadd_ps(ef, _mm512_set1_ps(LN2_LO), y);
+	y = _mm512_fnmadd_ps(x2, _mm512_set1_ps(0.5f), y);
+
+	return _mm512_fmadd_ps(ef, _mm512_set1_ps(LN2_HI), _mm512_add_ps(x, y));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 ForceScaleAVX512(const PairForceParams& p, __m512 r, __m512 ri, __m512 rj) {
+	const __m512 z = _mm512_maskz_max_ps(AVX512_ALL, _mm512_sub_ps(_mm512_sub_ps(r, ri), rj), _mm512_set1_ps(p.minDist));
+	const __m512 lnz = LnAVX512(z);
+	const __m512 t1 = _mm512_mul_ps(_mm512_set1_ps(-p.s1 * LOG2E), lnz);
+	const __m512 t2 = _mm512_mul_ps(_mm512_set1_ps(-p.s2 * LOG2E), lnz);
+	const __m512 s = _mm512_fmadd_ps(_mm512_set1_ps(p.c1), Exp2AVX512(t1), _mm512_mul_ps(_mm512_set1_ps(p.c2), Exp2AVX512(t2)));
+
+	return _mm512_div_ps(s, r);
+}
+
+__attribute__((target("avx512f")))
+static inline float SumAVX512(const float* s) {
+	// halves, then quarters and so on, as _mm512_reduce_add_ps
+	float h[8];
+
+	for (int k = 0; k < 8; k++) {
+		h[k] = s[k + 8] + s[k];
+	}
+	for (int k = 0; k < 4; k++) {
+		h[k] = h[k + 4] + h[k];
+	}
+
+	return ((h[0] + h[2]) + (h[1] + h[3]));
+}
+
+__attribute__((target("avx512f")))
+static inline vec3 SumAVX512(__m512 fx, __m512 fy, __m512 fz) {
+	float sx[16], sy[16], sz[16];
+	_mm512_storeu_ps(sx, fx);
+	_mm512_storeu_ps(sy, fy);
+	_mm512_storeu_ps(sz, fz);
+
+	return vec3(SumAVX512(sx), SumAVX512(sy), SumAVX512(sz));
+}
+
+__attribute__((target("avx512f")))
+static void AddForcesAVX512(const PairForceParams& _p, const float* px, const float* py, const float* pz, const float* radius, unsigned int n, unsigned int i, vec3& force) {
+	const PairForceParams p = _p;
+	const __m512 xi = _mm512_set1_ps(px[i]);
+	const __m512 yi = _mm512_set1_ps(py[i]);
+	const __m512 zi = _mm512_set1_ps(pz[i]);
+	const __m512 ri = _mm512_set1_ps(radius[i]);
+	const __m512i nv = _mm512_set1_epi32(n);
+	const __m512i iv = _mm512_set1_epi32(i);
+
+	__m512i idx = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	__m512 fx = _mm512_setzero_ps();
+	__m512 fy = _mm512_setzero_ps();
+	__m512 fz = _mm512_setzero_ps();
+
+	for (unsigned int j = 0; j < n; j += 16) {
+		const __m512 dx = _mm512_sub_ps(xi, _mm512_loadu_ps(px + j));
+		const __m512 dy = _mm512_sub_ps(yi, _mm512_loadu_ps(py + j));
+		const __m512 dz = _mm512_sub_ps(zi, _mm512_loadu_ps(pz + j));
+		const __m512 r = _mm512_maskz_sqrt_ps(AVX512_ALL, _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dz, dz))));
+
+		const __mmask16 valid = _mm512_cmplt_epi32_mask(idx, nv) & _mm512_cmpneq_epi32_mask(idx, iv);
+		const __m512 k = ForceScaleAVX512(p, r, ri, _mm512_loadu_ps(radius + j));
+
+		// invalid lanes keep their sums
+		fx = _mm512_mask3_fmadd_ps(dx, k, fx, valid);
+		fy = _mm512_mask3_fmadd_ps(dy, k, fy, valid);
+		fz = _mm512_mask3_fmadd_ps(dz, k, fz, valid);
+		idx = _mm512_add_epi32(idx, _mm512_set1_epi32(16));
+	}
+
+	force += SumAVX512(fx, fy, fz);
+}
+
+__attribute__((target("avx512f")))
+static void AddPairForcesAVX512(const PairForceParams& _p, const float* px, const float* py, const float* pz, const float* radius, unsigned int n, unsigned int i, float* fxs, float* fys, float* fzs) {
+	const PairForceParams p = _p;
+	const __m512 xi = _mm512_set1_ps(px[i]);
+	const __m512 yi = _mm512_set1_ps(py[i]);
+	const __m512 zi = _mm512_set1_ps(pz[i]);
+	const __m512 ri = _mm512_set1_ps(radius[i]);
+	const __m512i nv = _mm512_set1_epi32(n);
+	const __m512i iv = _mm512_set1_epi32(i);
+	const unsigned int j0 = (i + 1) & ~15u;
+
+	__m512i idx = _mm512_add_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(j0));
+	__m512 fx = _mm512_setzero_ps();
+	__m512 fy = _mm512_setzero_ps();
+	__m512 fz = _mm512_setzero_ps();
+
+	for (unsigned int j = j0; j < n; j += 16) {
+		const __m512 dx = _mm512_sub_ps(xi, _mm512_loadu_ps(px + j));
+		const __m512 dy = _mm512_sub_ps(yi, _mm512_loadu_ps(py + j));
+		const __m512 dz = _mm512_sub_ps(zi, _mm512_loadu_ps(pz + j));
+		const __m512 r = _mm512_maskz_sqrt_ps(AVX512_ALL, _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dz, dz))));
+
+		const __mmask16 valid = _mm512_cmpgt_epi32_mask(idx, iv) & _mm512_cmplt_epi32_mask(idx, nv);
+		const __m512 k = ForceScaleAVX512(p, r, ri, _mm512_loadu_ps(radius + j));
+
+		// the dropped lanes are neither summed nor written
+		fx = _mm512_mask3_fmadd_ps(dx, k, fx, valid); _mm512_mask_storeu_ps(fxs + j, valid, _mm512_fnmadd_ps(dx, k, _mm512_loadu_ps(fxs + j)));
+		fy = _mm512_mask3_fmadd_ps(dy, k, fy, valid); _mm512_mask_storeu_ps(fys + j, valid, _mm512_fnmadd_ps(dy, k, _mm512_loadu_ps(fys + j)));
+		fz = _mm512_mask3_fmadd_ps(dz, k, fz, valid); _mm512_mask_storeu_ps(fzs + j, valid, _mm512_fnmadd_ps(dz, k, _mm512_loadu_ps(fzs + j)));
+		idx = _mm512_add_epi32(idx, _mm512_set1_epi32(16));
+	}
+
+	const vec3 sum = SumAVX512(fx, fy, fz);
+
+	fxs[i] += sum.x;
+	fys[i] += sum.y;
+	fzs[i] += sum.z;
+}
+
+__attribute__((target("avx512f")))
+static void PowAVX512(const float* z, float s, float* out, unsigned int n) {
+	for (unsigned int k = 0; k < n; k += 16) {
+		_mm512_storeu_ps(out + k, Exp2AVX512(_mm512_mul_ps(_mm512_set1_ps(-s * LOG2E), LnAVX512(_mm512_loadu_ps(z + k)))));
+	}
+}
+#endif
+
+
+
+CPairKernel::CPairKernel(const PairForceParams& p, pairKernelType t): params(p) {
+	SetType(t);
+}
+
+void CPairKernel::SetType(pairKernelType t) {
+	if (t == PAIR_KERNEL_AUTO || !IsSupported(t)) {
+		t = PAIR_KERNEL_SCALAR;
+
+		if (IsSupported(PAIR_KERNEL_SSE2  )) { t = PAIR_KERNEL_SSE2;   }
+		if (IsSupported(PAIR_KERNEL_AVX2  )) { t = PAIR_KERNEL_AVX2;   }
+		if (IsSupported(PAIR_KERNEL_AVX512)) { t = PAIR_KERNEL_AVX512; }
+	}
+
+	type = t;
+	func = AddForcesScalar;
+	pairFunc = AddPairForcesScalar;
+
+	#if (PAIR_KERNEL_X86 == 1)
+	switch (type) {
+		case PAIR_KERNEL_SSE2:   { func = AddForcesSSE2;   pairFunc = AddPairForcesSSE2;   } break;
+		case PAIR_KERNEL_AVX2:   { func = AddForcesAVX2;   pairFunc = AddPairForcesAVX2;   } break;
+		case PAIR_KERNEL_AVX512: { func = AddForcesAVX512; pairFunc = AddPairForcesAVX512; } break;
+		default: {} break;
+	}
+	#endif
+}
+
+bool CPairKernel::IsSupported(pairKernelType t) {
+	#if (PAIR_KERNEL_X86 == 1)
+	__builtin_cpu_init();
+
+	switch (t) {
+		case PAIR_KERNEL_SCALAR: { return true; } break;
+		case PAIR_KERNEL_SSE2:   { return __builtin_cpu_supports("sse2"); } break;
+		case PAIR_KERNEL_AVX2:   { return (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")); } break;
+		case PAIR_KERNEL_AVX512: { return __builtin_cpu_supports("avx512f"); } break;
+		default: {} break;
+	}
+
+	return false;
+	#else
+	return (t == PAIR_KERNEL_SCALAR);
+	#endif
+}
+
+const char* CPairKernel::GetName(pairKernelType t) {
+	static const char* names[] = {"scalar", "SSE2", "AVX2", "AVX-512", "auto"};
+	return names[t];
+}
+
+double CPairKernel::MeasurePowError(pairKernelType t, float s, float lo, float hi, unsigned int numSamples) {
+	if (!IsSupported(t))
+		return -1.0;
+
+	// whole steps of the widest kernel
+	const unsigned int padded = (numSamples + 15) & ~15u;
+
+	std::vector<float> z(padded, 1.0f);
+	std::vector<float> out(padded, 1.0f);
+
+	for (unsigned int k = 0; k < numSamples; k++) {
+		z[k] = lo * powf(hi / lo, float(k) / std::max(numSamples - 1, 1u));
+	}
+
+	PowScalar(&z[0], s, &out[0], padded);
+
+	#if (PAIR_KERNEL_X86 == 1)
+	switch (t) {
+		case PAIR_KERNEL_SSE2:   { PowSSE2(&z[0], s, &out[0], padded);   } break;
+		case PAIR_KERNEL_AVX2:   { PowAVX2(&z[0], s, &out[0], padded);   } break;
+		case PAIR_KERNEL_AVX512: { PowAVX512(&z[0], s, &out[0], padded); } break;
+		default: {} break;
+	}
+	#endif
+
+	double maxErr = 0.0;
+
+	for (unsigned int k = 0; k < numSamples; k++) {
+		const double ref = pow(double(z[k]), -double(s));
+		maxErr = std::max(maxErr, fabs(out[k] - ref) / ref);
+	}
+
+	return maxErr;
+}
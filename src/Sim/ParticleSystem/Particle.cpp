@@ -1,7 +1,48 @@
 #include "./Particle.hpp"
 
-Particle::Particle() {
-	mass = 2.0f;
-	radius = 0.05;
-	sliceIdx = 0;
+// the state of unused elements
+#define REST_MASS	2.0f
+#define REST_RADIUS	0.05f
+
+void ParticleArrays::Resize(unsigned int n) {
+	const unsigned int padded = GetPaddedSize(n);
+
+	ParticleArray* comps[] = {
+		&posX, &posY, &posZ,
+		&velX, &velY, &velZ,
+		&forceX, &forceY, &forceZ,
+		&borderX, &borderY, &borderZ,
+	};
+
+	for (unsigned int c = 0; c < sizeof(comps) / sizeof(comps[0]); c++) {
+		comps[c]->assign(padded, 0.0f);
+	}
+
+	mass.assign(padded, REST_MASS);
+	radius.assign(padded, REST_RADIUS);
+	sliceIdx.assign(padded, 0);
+
+	size = n;
+}
+
+void ParticleArrays::Move(unsigned int dst, unsigned int src) {
+	SetPos(dst, GetPos(src));
+	SetVelocity(dst, GetVelocity(src));
+	SetForce(dst, GetForce(src));
+	SetBorderForce(dst, GetBorderForce(src));
+
+	mass[dst] = mass[src];
+	radius[dst] = radius[src];
+	sliceIdx[dst] = sliceIdx[src];
+}
+
+void ParticleArrays::Clear(unsigned int i) {
+	SetPos(i, NVec);
+	SetVelocity(i, NVec);
+	SetForce(i, NVec);
+	SetBorderForce(i, NVec);
+
+	mass[i] = REST_MASS;
+	radius[i] = REST_RADIUS;
+	sliceIdx[i] = 0;
 }
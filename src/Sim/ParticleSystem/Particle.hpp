@@ -1,28 +1,101 @@
 #ifndef PARTICLE_HPP
 #define PARTICLE_HPP
 
+#include <new>
+#include <vector>
+#include <cstddef>
+
 #include "../../Math/vec3.hpp"
 
+// the particle arrays start on (and are padded to) this
+// many bytes, the width of the widest vector registers
+#define PARTICLE_ALIGNMENT 64
+
+template<typename T> struct ParticleAllocator {
+	typedef T value_type;
+
+	ParticleAllocator() {}
+	template<typename U> ParticleAllocator(const ParticleAllocator<U>&) {}
+
+	T* allocate(std::size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(PARTICLE_ALIGNMENT))); }
+	void deallocate(T* p, std::size_t) { ::operator delete(p, std::align_val_t(PARTICLE_ALIGNMENT)); }
+
+	template<typename U> bool operator == (const ParticleAllocator<U>&) const { return true; }
+	template<typename U> bool operator != (const ParticleAllocator<U>&) const { return false; }
+};
+
+typedef std::vector<float, ParticleAllocator<float> > ParticleArray;
+typedef std::vector<unsigned int, ParticleAllocator<unsigned int> > ParticleIndexArray;
+
+// the state of all particles of a system, one array per
+// component (element i of each belongs to particle i); the
+// arrays hold <size> particles rounded up to a multiple of
+// PARTICLE_ALIGNMENT bytes, the padding is kept at rest
+struct ParticleArrays {
+	ParticleArrays(): size(0) {}
+
+	void Resize(unsigned int n);
+	// copies particle <src> over particle <dst>
+	void Move(unsigned int dst, unsigned int src);
+	// puts particle <i> back at rest (as Resize leaves it)
+	void Clear(unsigned int i);
+
+	// length of the arrays for <n> particles
+	static unsigned int GetPaddedSize(unsigned int n) {
+		const unsigned int perLine = PARTICLE_ALIGNMENT / sizeof(float);
+		return ((n + perLine - 1) & ~(perLine - 1));
+	}
+
+	vec3 GetPos(unsigned int i) const { return vec3(posX[i], posY[i], posZ[i]); }
+	vec3 GetVelocity(unsigned int i) const { return vec3(velX[i], velY[i], velZ[i]); }
+	vec3 GetForce(unsigned int i) const { return vec3(forceX[i], forceY[i], forceZ[i]); }
+	vec3 GetBorderForce(unsigned int i) const { return vec3(borderX[i], borderY[i], borderZ[i]); }
+
+	// component <c> (0: x, 1: y, 2: z) of the vector arrays
+	float* GetPosData(unsigned int c) { ParticleArray* a[] = {&posX, &posY, &posZ}; return &(*a[c])[0]; }
+	float* GetVelocityData(unsigned int c) { ParticleArray* a[] = {&velX, &velY, &velZ}; return &(*a[c])[0]; }
+	float* GetForceData(unsigned int c) { ParticleArray* a[] = {&forceX, &forceY, &forceZ}; return &(*a[c])[0]; }
+
+	void SetPos(unsigned int i, const vec3& v) { posX[i] = v.x; posY[i] = v.y; posZ[i] = v.z; }
+	void SetVelocity(unsigned int i, const vec3& v) { velX[i] = v.x; velY[i] = v.y; velZ[i] = v.z; }
+	void SetForce(unsigned int i, const vec3& v) { forceX[i] = v.x; forceY[i] = v.y; forceZ[i] = v.z; }
+	void SetBorderForce(unsigned int i, const vec3& v) { borderX[i] = v.x; borderY[i] = v.y; borderZ[i] = v.z; }
+
+	unsigned int size;
+
+	ParticleArray posX, posY, posZ;
+	ParticleArray velX, velY, velZ;
+	ParticleArray forceX, forceY, forceZ;
+	ParticleArray borderX, borderY, borderZ;
+	ParticleArray mass;
+	ParticleArray radius;
+	ParticleIndexArray sliceIdx;
+};
+
+// view of one particle of a system by position (valid as
+// long as no particle is removed, which moves the last one
+// into the gap; a ParticleHandle follows it)
 class Particle {
 	public:
-		Particle();
-		~Particle() {}
-
-		float radius;
-		float mass;
-		vec3 pos;
-		vec3 velocity;
-		vec3 force;
-		vec3 borderForce;
-		unsigned int sliceIdx;
-
-		bool operator < (const Particle* p) const {
-			return (sliceIdx < p->sliceIdx);
-		}
-
-		bool operator () (const Particle* p, const Particle* q) const {
-			return (p->sliceIdx > q->sliceIdx);
-		}
+		Particle(ParticleArrays* a, unsigned int i): arrays(a), idx(i) {}
+
+		vec3 GetPos() const { return arrays->GetPos(idx); }
+		vec3 GetVelocity() const { return arrays->GetVelocity(idx); }
+		vec3 GetForce() const { return arrays->GetForce(idx); }
+		vec3 GetBorderForce() const { return arrays->GetBorderForce(idx); }
+		float GetRadius() const { return arrays->radius[idx]; }
+		float GetMass() const { return arrays->mass[idx]; }
+		unsigned int GetSliceIdx() const { return arrays->sliceIdx[idx]; }
+		unsigned int GetIndex() const { return idx; }
+
+		void SetPos(const vec3& v) { arrays->SetPos(idx, v); }
+		void SetVelocity(const vec3& v) { arrays->SetVelocity(idx, v); }
+		void SetRadius(float r) { arrays->radius[idx] = r; }
+		void SetMass(float m) { arrays->mass[idx] = m; }
+
+	private:
+		ParticleArrays* arrays;
+		unsigned int idx;
 };
 
 #endif
@@ -0,0 +1,62 @@
+#include <algorithm>
+
+#include "./ParticlePool.hpp"
+
+CParticlePool::CParticlePool(unsigned int capacity) {
+	// the highest slot stays out of reach of PARTICLE_NO_HANDLE
+	capacity = std::min(capacity, PARTICLE_SLOT_MASK);
+
+	slotIndices.resize(capacity);
+	slotGenerations.resize(capacity, 0);
+	indexSlots.resize(capacity, 0);
+
+	// taken in order, so the first particles' handles and
+	// positions are the same
+	for (unsigned int s = 0; s < capacity; s++) {
+		slotIndices[s] = s + 1;
+	}
+
+	freeSlot = (capacity > 0)? 0: PARTICLE_NO_INDEX;
+	size = 0;
+
+	if (capacity > 0) {
+		slotIndices[capacity - 1] = PARTICLE_NO_INDEX;
+	}
+}
+
+ParticleHandle CParticlePool::Allocate() {
+	if (freeSlot == PARTICLE_NO_INDEX)
+		return PARTICLE_NO_HANDLE;
+
+	const unsigned int slot = freeSlot;
+
+	freeSlot = slotIndices[slot];
+	slotIndices[slot] = size;
+	indexSlots[size] = slot;
+	size += 1;
+
+	return (slot | (slotGenerations[slot] << PARTICLE_SLOT_BITS));
+}
+
+bool CParticlePool::Free(ParticleHandle h, unsigned int* idx, unsigned int* last) {
+	if (GetIndex(h) == PARTICLE_NO_INDEX)
+		return false;
+
+	const unsigned int slot = h & PARTICLE_SLOT_MASK;
+	const unsigned int lastSlot = indexSlots[size - 1];
+
+	*idx = slotIndices[slot];
+	*last = size - 1;
+
+	// the last particle takes the freed one's place
+	slotIndices[lastSlot] = *idx;
+	indexSlots[*idx] = lastSlot;
+	size -= 1;
+
+	// handles to the slot's old particle no longer match
+	slotGenerations[slot] = (slotGenerations[slot] + 1) & (PARTICLE_NO_HANDLE >> PARTICLE_SLOT_BITS);
+	slotIndices[slot] = freeSlot;
+	freeSlot = slot;
+
+	return true;
+}
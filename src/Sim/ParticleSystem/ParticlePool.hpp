@@ -0,0 +1,65 @@
+#ifndef PARTICLEPOOL_HPP
+#define PARTICLEPOOL_HPP
+
+#include <vector>
+
+// names a particle for as long as it lives, wherever its
+// state is moved to in the meantime: a slot of the pool in
+// the low PARTICLE_SLOT_BITS bits, the slot's generation
+// (bumped whenever the slot is freed) in the others
+typedef unsigned int ParticleHandle;
+
+#define PARTICLE_SLOT_BITS 24
+#define PARTICLE_SLOT_MASK ((1u << PARTICLE_SLOT_BITS) - 1)
+#define PARTICLE_NO_HANDLE 0xFFFFFFFFu
+#define PARTICLE_NO_INDEX  0xFFFFFFFFu
+
+// hands out the slots of up to <capacity> particles whose
+// state is kept densely in [0, size): a new particle goes
+// at the end, a freed one is replaced by the last (swap and
+// pop), and the slots map between handles and positions
+//
+// free slots form a list threaded through the slots' index
+// entries, so both are O(1) and the pool never allocates
+// after construction
+class CParticlePool {
+	public:
+		CParticlePool(unsigned int capacity);
+
+		unsigned int GetCapacity() const { return slotIndices.size(); }
+		unsigned int GetSize() const { return size; }
+
+		// PARTICLE_NO_HANDLE if all slots are taken; the new
+		// particle's position is GetSize() - 1
+		ParticleHandle Allocate();
+		// false if <h> is stale; otherwise the state at <*last>
+		// must be moved to <*idx> (unless they are the same),
+		// which is where its handle now points
+		bool Free(ParticleHandle h, unsigned int* idx, unsigned int* last);
+
+		// PARTICLE_NO_INDEX if <h> is stale
+		unsigned int GetIndex(ParticleHandle h) const {
+			const unsigned int slot = h & PARTICLE_SLOT_MASK;
+
+			if (slot >= slotIndices.size() || (h >> PARTICLE_SLOT_BITS) != slotGenerations[slot])
+				return PARTICLE_NO_INDEX;
+
+			return slotIndices[slot];
+		}
+		ParticleHandle GetHandle(unsigned int idx) const {
+			const unsigned int slot = indexSlots[idx];
+			return (slot | (slotGenerations[slot] << PARTICLE_SLOT_BITS));
+		}
+
+	private:
+		// position of each slot's particle, or (free slots) the
+		// next free slot; the slot of each position
+		std::vector<unsigned int> slotIndices;
+		std::vector<unsigned int> slotGenerations;
+		std::vector<unsigned int> indexSlots;
+
+		unsigned int freeSlot;
+		unsigned int size;
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include "../../Math/Constants.hpp"
 
 #include <algorithm>
+#include <SDL/SDL_timer.h>
 
 #define S1						1.1f
 #define S2						1.2f
@@ -17,23 +18,68 @@
 #define DRAG_COEFF				0.90f
 #define MAX_FORCE				5.0f
 #define MAX_SLICE_SEPARATION	30
+// below this many particles the pair forces are one chunk,
+// from there on they are split into PAIRS_NUM_CHUNKS
+#define PAIRS_MIN_PARALLEL		1024
+#define PAIRS_NUM_CHUNKS		64
+
+// repulsion exerted on a particle of radius <ri> by one of
+// radius <rj> with their centers <d> apart
+static inline vec3 PairForce(const vec3& d, float ri, float rj) {
+	float r		= d.len3D();
+	float z		= r - ri - rj;
+
+	z = (z < EPSILON)? EPSILON: z;
+
+	float d1	= powf(z, S1);
+	float d2	= powf(z, S2);
+	float s		= (C1 / d1) + (C2 / d2);
+
+	return ((d / r) * s);
+}
+
+static const PairForceParams pairForceParams = {C1, S1, C2, S2, EPSILON};
+
+CParticleSystem::CParticleSystem(int _numParticles, int maxParticles):
+	particlePool(std::max(_numParticles, maxParticles)),
+	pairKernel(pairForceParams)
+{
+	const unsigned int capacity = particlePool.GetCapacity();
 
-CParticleSystem::CParticleSystem(int _numParticles) {
 	numParticles = _numParticles;
 	inited = false;
+	cutoff = 0.0f;
+	barnesHutTheta = 0.0f;
+	barnesHut.SetThreadPool(&pool);
+	integrator = INTEGRATOR_EULER;
 
-	particles.resize(numParticles, 0);
+	// particles come and go without touching the heap
+	sparticles.reserve(capacity);
 	sparticles.resize(numParticles, 0);
-	temp1.resize(numParticles * 6);
-	temp2.resize(numParticles * 6);
+	sortScratch.reserve(capacity);
+	sortScratch.resize(numParticles, 0);
+	// a group further apart than this is pulled back together
+	sliceCounts.reserve(MAX_SLICE_SEPARATION + 1);
+	minSlice = 0;
+	maxSlice = 0;
+	resort = false;
+	emitRate = 0.0f;
+	emitDebt = 0.0f;
+	positions.reserve(capacity);
+	positions.resize(numParticles);
+	radii.reserve(capacity);
+	radii.resize(numParticles);
+	pairForces.reserve(capacity);
+	pairForces.resize(numParticles);
+
+	for (int i = 0; i < numParticles; i++) {
+		particlePool.Allocate();
+	}
 
 	CreateParticles();
 }
 
 CParticleSystem::~CParticleSystem() {
-	for (int i = 0; i < numParticles; i++) {
-		delete particles[i]; particles[i] = 0x0;
-	}
 }
 
 void CParticleSystem::SetAttractionPoint(float x, float y) {
@@ -42,38 +88,57 @@ void CParticleSystem::SetAttractionPoint(float x, float y) {
 }
 
 void CParticleSystem::CreateParticles() {
+	arrays.Resize(particlePool.GetCapacity());
+
 	for (int i = 0; i < numParticles; i++) {
-		Particle* p = new Particle();
 		float r = (rng.RandInt(10) / 400.0f);
 
-		p->radius = r + 0.1f;
-		p->mass = (p->radius * 10.0f) + 1.0f;
+		arrays.radius[i] = r + 0.1f;
+		arrays.mass[i] = (arrays.radius[i] * 10.0f) + 1.0f;
 
-		particles[i] = p;
-		sparticles[i] = p;
+		sparticles[i] = i;
 	}
 }
 
-void CParticleSystem::AddParticle(const vec3&, float) {
+ParticleHandle CParticleSystem::AddParticle(const vec3& pos, float radius) {
 	// note: check if inside the bounding box first?
-	/*
-	Particle* p = new Particle();
-	p->pos.x = pos.x;
-	p->pos.y = pos.y;
-	p->pos.z = pos.z;
-	p->radius = radius;
-	p->mass = p->radius * 100.0f + 1.0f;
+	const ParticleHandle h = particlePool.Allocate();
+
+	if (h == PARTICLE_NO_HANDLE) {
+		return h;
+	}
+
+	const unsigned int i = numParticles++;
+
+	arrays.Clear(i);
+	arrays.SetPos(i, pos);
+	arrays.radius[i] = radius;
+	arrays.mass[i] = (radius * 10.0f) + 1.0f;
 
-	particles.push_back(p);
-	numParticles++;
-	temp1.resize(numParticles * 6);
-	temp2.resize(numParticles * 6);
-	printf("particle %d spawned @ <%+.2f, %+.2f>\n", numParticles, p->pos.x, p->pos.y);
-	*/
+	// at the lowest slice, so the order still holds
+	sparticles.push_back(i);
+	return h;
 }
 
-Particle* CParticleSystem::GetParticle(int i) {
-	return particles[i];
+bool CParticleSystem::RemoveParticle(ParticleHandle h) {
+	unsigned int idx = 0;
+	unsigned int last = 0;
+
+	if (!particlePool.Free(h, &idx, &last)) {
+		return false;
+	}
+
+	if (idx != last) {
+		arrays.Move(idx, last);
+	}
+
+	// the padding has to stay at rest
+	arrays.Clear(last);
+	numParticles -= 1;
+
+	sparticles.pop_back();
+	resort = true;
+	return true;
 }
 
 void CParticleSystem::InitParticles(CPathFinder* pf) {
@@ -84,7 +149,6 @@ void CParticleSystem::InitParticles(CPathFinder* pf) {
 	BoundingCircle& bc = pf->tunnel.front();
 
 	for (int i = 0; i < numParticles; i++) {
-		Particle* p = GetParticle(i);
 		int layer = i / bc.numSegments;
 		float rmod = 0.8f - (layer * 0.2f);
 
@@ -98,10 +162,10 @@ void CParticleSystem::InitParticles(CPathFinder* pf) {
 		const float y = bc.radius * rmod * sinf(DTOR(a2));
 		vec3 pos(x, y, 0.0f);
 
-		p->pos = bc.m.Mul(pos);
-		p->velocity = NVec;
-		p->force = NVec;
-		p->sliceIdx = 0;
+		arrays.SetPos(i, bc.m.Mul(pos));
+		arrays.SetVelocity(i, NVec);
+		arrays.SetForce(i, NVec);
+		arrays.sliceIdx[i] = 0;
 	}
 
 	inited = true;
@@ -109,91 +173,342 @@ void CParticleSystem::InitParticles(CPathFinder* pf) {
 
 
 
-inline bool SortParticlesFunc(const Particle* p, const Particle* q) {
-	return (p->sliceIdx > q->sliceIdx);
-}
-
 void CParticleSystem::Update(float deltaT, CPathFinder* pf) {
 	if (!inited) {
 		return;
 	}
 
-	std::sort(sparticles.begin(), sparticles.end(), &SortParticlesFunc);
+	SortBySlice();
+
+	switch (integrator) {
+		case INTEGRATOR_EULER: {
+			ComputeForces(pf);
+			ParallelFor(numParticles, [&](unsigned int i0, unsigned int i1) { EulerPass(deltaT, i0, i1); });
+		} break;
+		case INTEGRATOR_SEMI_IMPLICIT: {
+			ComputeForces(pf);
+			ParallelFor(numParticles, [&](unsigned int i0, unsigned int i1) { SemiImplicitPass(deltaT, i0, i1); });
+		} break;
+		case INTEGRATOR_VERLET: {
+			// the forces of the last step are those at the
+			// current positions, so one evaluation per step
+			ParallelFor(numParticles, [&](unsigned int i0, unsigned int i1) { VerletDriftPass(deltaT, i0, i1); });
+			ComputeForces(pf);
+			ParallelFor(numParticles, [&](unsigned int i0, unsigned int i1) { VerletKickPass(deltaT, i0, i1); });
+		} break;
+		case INTEGRATOR_RK4: {
+			ResizeRK4();
+			ParallelFor(numParticles, [&](unsigned int i0, unsigned int i1) { RK4BeginPass(i0, i1); });
 
-	GetDerivative(pf, temp1);
-	ScaleVector(temp1, deltaT);
-	GetState(temp2);
-	AddVectors(temp1, temp2, temp2);
-	SetState(temp2);
+			for (unsigned int stage = 0; stage < 4; stage++) {
+				ComputeForces(pf);
+				ParallelFor(numParticles, [&](unsigned int i0, unsigned int i1) { RK4StagePass(stage, deltaT, i0, i1); });
+			}
+		} break;
+		default: {
+		} break;
+	}
+
+	if (emitRate > 0.0f) {
+		RetireParticles(pf);
+		EmitParticles(pf, deltaT);
+	}
 }
 
+void CParticleSystem::RetireParticles(CPathFinder* pf) {
+	const unsigned int lastSlice = pf->tunnel.size() - 1;
+
+	// as of the start of the step (particles that arrived
+	// since then leave on the next)
+	if (numParticles == 0 || maxSlice < lastSlice) {
+		return;
+	}
+
+	for (int i = numParticles - 1; i >= 0; i--) {
+		// whichever particle takes i's place was seen already
+		if (arrays.sliceIdx[i] >= lastSlice) {
+			RemoveParticle(particlePool.GetHandle(i));
+		}
+	}
+}
+
+void CParticleSystem::EmitParticles(CPathFinder* pf, float deltaT) {
+	if (pf->tunnel.empty()) {
+		return;
+	}
+
+	const BoundingCircle& bc = pf->tunnel.front();
+
+	// a steady flow spreads out over the whole tunnel, so
+	// SortBySlice's counts can need a bucket per slice
+	sliceCounts.reserve(pf->tunnel.size());
+
+	emitDebt += (emitRate * deltaT);
+
+	while (emitDebt >= 1.0f) {
+		const float a = DTOR(rng.RandFloat(360.0f));
+		const float r = bc.radius * 0.8f * sqrtf(rng.RandFloat());
+
+		emitDebt -= 1.0f;
+
+		if (AddParticle(bc.m.Mul(vec3(r * cosf(a), r * sinf(a), 0.0f)), (rng.RandInt(10) / 400.0f) + 0.1f) == PARTICLE_NO_HANDLE) {
+			// no room; the flow does not catch up later
+			emitDebt = 0.0f; break;
+		}
+	}
+}
+
+void CParticleSystem::ResizeRK4() {
+	if (rk4.pos[0].size() == arrays.posX.size())
+		return;
+
+	for (unsigned int c = 0; c < 3; c++) {
+		rk4.pos[c].resize(arrays.posX.size());
+		rk4.vel[c].resize(arrays.posX.size());
+		rk4.force[c].resize(arrays.posX.size());
+		rk4.sumVel[c].resize(arrays.posX.size());
+		rk4.sumAcc[c].resize(arrays.posX.size());
+	}
+
+	rk4.slice.resize(arrays.posX.size());
+}
+
+const char* CParticleSystem::GetIntegratorName(integratorType t) {
+	static const char* names[] = {"Euler", "semi-implicit Euler", "velocity Verlet", "RK4"};
+	return ((t < NUM_INTEGRATORS)? names[t]: "unknown");
+}
+
+
+
+void CParticleSystem::SortBySlice() {
+	const unsigned int n = numParticles;
+
+	// the last particle took a removed one's place, so
+	// start over from the order of the arrays
+	if (resort) {
+		for (unsigned int k = 0; k < n; k++) {
+			sparticles[k] = k;
+		}
+
+		resort = false;
+	}
+
+	if (n == 0)
+		return;
+
+	bool sorted = true;
 
+	minSlice = arrays.sliceIdx[sparticles[0]];
+	maxSlice = minSlice;
+
+	// particles move on by a slice or so per step at most, so
+	// the last step's order often still holds, and otherwise
+	// the particles span only a few slices
+	for (unsigned int k = 1; k < n; k++) {
+		const unsigned int s = arrays.sliceIdx[sparticles[k]];
+
+		sorted = sorted && (s <= arrays.sliceIdx[sparticles[k - 1]]);
+		minSlice = std::min(minSlice, s);
+		maxSlice = std::max(maxSlice, s);
+	}
+
+	if (sorted)
+		return;
+
+	// counting sort over [minSlice, maxSlice], highest first
+	// (stable, so each slice keeps its particles' order)
+	sliceCounts.assign(maxSlice - minSlice + 1, 0);
+	sortScratch.resize(n);
+
+	for (unsigned int k = 0; k < n; k++) {
+		sliceCounts[maxSlice - arrays.sliceIdx[sparticles[k]]]++;
+	}
+
+	for (unsigned int b = 0, start = 0; b < sliceCounts.size(); b++) {
+		const unsigned int count = sliceCounts[b];
+
+		sliceCounts[b] = start;
+		start += count;
+	}
+
+	for (unsigned int k = 0; k < n; k++) {
+		const unsigned int p = sparticles[k];
+		sortScratch[sliceCounts[maxSlice - arrays.sliceIdx[p]]++] = p;
+	}
+
+	sparticles.swap(sortScratch);
+}
 
 void CParticleSystem::ComputeForces(CPathFinder* pf) {
-	for (int x = 0; x < numParticles; x++) {
-		Particle* i = GetParticle(x);
+	ComputePairForces();
+
+	// in slice order, so every chunk has about as many
+	// particles and sees a narrow range of slices only
+	ParallelFor(numParticles, [&](unsigned int i0, unsigned int i1) {
+		for (unsigned int k = i0; k < i1; k++) {
+			const unsigned int x = sparticles[k];
+
+			if (arrays.sliceIdx[x] >= pf->tunnel.size() - 1) {
+				arrays.SetForce(x, NVec); continue;
+			}
 
-		if (i->sliceIdx >= pf->tunnel.size() - 1) {
-			i->force = NVec; continue;
+			vec3 bfi = ComputeBorderForce(pf, x);
+			vec3 fi = arrays.GetForce(x);
+
+			fi += pairForces[x];
+
+			if (fi.len3D() > MAX_FORCE) {
+				fi.norm();
+				fi *= MAX_FORCE;
+			}
+
+			fi += bfi;
+
+			arrays.SetForce(x, fi);
+			arrays.SetBorderForce(x, bfi);
 		}
+	});
+}
 
-		vec3 bfi = ComputeBorderForce(pf, i);
+void CParticleSystem::ComputePairForces() {
+	const unsigned int n = numParticles;
+	const unsigned int numChunks = (n >= PAIRS_MIN_PARALLEL)? PAIRS_NUM_CHUNKS: 1;
 
-		// calculate the forces between all the particles and i
-		for (int y = 0; y < numParticles; y++) {
-			if (y == x) continue;
+	positions.resize(n);
+	radii.resize(n);
+	pairForces.resize(n);
 
-			Particle* j	= GetParticle(y);
-			vec3 d		= i->pos - j->pos;
-			float r		= d.len3D();
-			float z		= r - i->radius - j->radius;
+	if (cutoff > 0.0f || barnesHutTheta > 0.0f) {
+		ParallelFor(n, [&](unsigned int i0, unsigned int i1) {
+			for (unsigned int i = i0; i < i1; i++) {
+				positions[i] = arrays.GetPos(i);
+				radii[i] = arrays.radius[i];
+			}
+		});
+	}
+
+	if (barnesHutTheta > 0.0f) {
+		barnesHut.Build(positions, radii);
+		barnesHut.ComputeForces(pairForces, PairForce);
+		return;
+	}
 
-			z = (z < EPSILON)? EPSILON: z;
+	pairBounds.assign(numChunks + 1, n);
+	pairBounds[0] = 0;
 
-			float d1	= powf(z, S1);
-			float d2	= powf(z, S2);
-			float s		= (C1 / d1) + (C2 / d2);
-			vec3 f		= (d / r) * s;
+	if (cutoff > 0.0f) {
+		cellList.Build(positions, cutoff);
 
-			i->force += f;
+		for (unsigned int c = 1; c < numChunks; c++) {
+			pairBounds[c] = (n * c) / numChunks;
 		}
+	} else {
+		// particle i has (n - 1 - i) pairs left for it,
+		// so the later ranges hold more particles
+		const double numPairs = 0.5 * n * (n - 1.0);
+		double pairs = 0.0;
 
-		if (i->force.len3D() > MAX_FORCE) {
-			i->force.norm();
-			i->force *= MAX_FORCE;
+		for (unsigned int i = 0, c = 1; i < n && c < numChunks; i++) {
+			while (c < numChunks && pairs >= (numPairs * c) / numChunks) {
+				pairBounds[c++] = i;
+			}
+
+			pairs += (n - 1 - i);
 		}
+	}
+
+	forceBuffers.resize(numChunks);
+
+	pool.Run(numChunks, [this](unsigned int c) {
+		SumPairForces(c);
+	});
 
-		i->force += bfi;
-		i->borderForce = bfi;
+	// every index sums the chunks that reach it in chunk
+	// order, whichever threads they ran on
+	ParallelFor(n, [&](unsigned int p0, unsigned int p1) {
+		for (unsigned int p = p0; p < p1; p++) {
+			vec3 f = NVec;
+
+			for (unsigned int c = 0; c < numChunks; c++) {
+				const ForceBuffer& b = forceBuffers[c];
+
+				if (p >= b.first && p < b.last) {
+					f += vec3(b.x[p - b.base], b.y[p - b.base], b.z[p - b.base]);
+				}
+			}
+
+			pairForces[(cutoff > 0.0f)? cellList.GetPoint(p): p] = f;
+		}
+	});
+}
+
+void CParticleSystem::SumPairForces(unsigned int c) {
+	const unsigned int n = numParticles;
+	const unsigned int a0 = pairBounds[c    ];
+	const unsigned int a1 = pairBounds[c + 1];
+
+	ForceBuffer& buf = forceBuffers[c];
+
+	if (cutoff > 0.0f) {
+		const float cutoffSq = cutoff * cutoff;
+
+		// the pairs of [a0, a1) in cell order stay within
+		// a few columns of cells after a1
+		buf.base = a0;
+		buf.first = a0;
+		buf.last = cellList.GetPairRangeEnd(a0, a1);
+
+		buf.x.assign(ParticleArrays::GetPaddedSize(buf.last - buf.base), 0.0f);
+		buf.y.assign(ParticleArrays::GetPaddedSize(buf.last - buf.base), 0.0f);
+		buf.z.assign(ParticleArrays::GetPaddedSize(buf.last - buf.base), 0.0f);
+
+		cellList.ForEachUniquePair(a0, a1, [&](unsigned int a, unsigned int b, const vec3& d) {
+			if (d.sqLen3D() < cutoffSq) {
+				const vec3 f = PairForce(d, radii[cellList.GetPoint(a)], radii[cellList.GetPoint(b)]);
+
+				buf.x[a - a0] += f.x; buf.y[a - a0] += f.y; buf.z[a - a0] += f.z;
+				buf.x[b - a0] -= f.x; buf.y[b - a0] -= f.y; buf.z[b - a0] -= f.z;
+			}
+		});
+	} else {
+		// the kernels index the particle arrays directly
+		buf.base = 0;
+		buf.first = a0;
+		buf.last = n;
+
+		buf.x.assign(ParticleArrays::GetPaddedSize(n), 0.0f);
+		buf.y.assign(ParticleArrays::GetPaddedSize(n), 0.0f);
+		buf.z.assign(ParticleArrays::GetPaddedSize(n), 0.0f);
+
+		for (unsigned int i = a0; i < a1; i++) {
+			pairKernel.AddPairForces(&arrays.posX[0], &arrays.posY[0], &arrays.posZ[0], &arrays.radius[0], n, i, &buf.x[0], &buf.y[0], &buf.z[0]);
+		}
 	}
 }
 
-vec3 CParticleSystem::ComputeBorderForce(CPathFinder* pf, Particle* p) {
+vec3 CParticleSystem::ComputeBorderForce(CPathFinder* pf, int i) {
 	bool update = true;
 	int count = 0;
 	vec3 force = NVec;
 
-	const unsigned int maxSlice = sparticles[               0]->sliceIdx;
-	const unsigned int minSlice = sparticles[numParticles - 1]->sliceIdx;
+	// the slices' planes, transforms and segment normals
+	// were worked out when the tunnel was built
+	const TunnelTables& tt = pf->tunnelTables;
+
+	const vec3 pos = arrays.GetPos(i);
 	const unsigned int midSlice = (maxSlice + minSlice) >> 1;
 	const bool isGroupSeparated = ((maxSlice - minSlice) > MAX_SLICE_SEPARATION);
 
 	while (update) {
-		const unsigned int sliceIdx	= p->sliceIdx;
-		const bool nextSlice		= (sliceIdx < (pf->tunnel.size() - 1));
-		const BoundingCircle& bcm	=            pf->tunnel[sliceIdx    ];
-		const BoundingCircle& bcn	= nextSlice? pf->tunnel[sliceIdx + 1]: bcm;
-		const vec3 sliceNormalM		= (bcm.m).GetDir(2);
-		const vec3 sliceNormalN		= (bcn.m).GetDir(2);
-		const vec3 slicePosM		= (bcm.m).GetDir(3);
-
-		const float distM = trig::PointPlaneDistance(p->pos, sliceNormalM, slicePosM);
+		const unsigned int sliceIdx	= arrays.sliceIdx[i];
+		const bool nextSlice		= (sliceIdx < (tt.numSlices - 1));
+
+		const float distM = tt.GetPlaneDistance(sliceIdx, pos);
 		const bool passedM = (distM < 0.0f);
 
-		const vec3 inposM = bcm.GetParticleInvPos(p->pos);
-		const vec3 forceM = bcm.GetForce(inposM);
+		const vec3 forceM = tt.GetSliceForce(sliceIdx, pos);
 
-		vec3 zForce = (sliceNormalM + sliceNormalN) * 3.0f;
+		vec3 zForce = tt.GetAxialForce(sliceIdx);
 
 		if (isGroupSeparated) {
 			if (sliceIdx > midSlice) { zForce *= 0.5f; } // slow down
@@ -205,59 +520,510 @@ vec3 CParticleSystem::ComputeBorderForce(CPathFinder* pf, Particle* p) {
 		count += 1;
 
 		if (update) {
-			p->sliceIdx++;
+			arrays.sliceIdx[i]++;
 		}
 	}
 
 	return (force / count);
 }
 
-void CParticleSystem::GetDerivative(CPathFinder* pf, std::vector<float> &dst) {
-	ComputeForces(pf);
-
-	for (int i = 0, j = 0; i < numParticles; i++) {
-		Particle* p = GetParticle(i);
-		dst[j++] = (p->velocity.x);
-		dst[j++] = (p->velocity.y);
-		dst[j++] = (p->velocity.z);
+// one component of n particles (a multiple of 4) per call;
+// the pointers never alias, which lets the loops vectorize
+//
+// x' = x + v * dt, v' = v * drag + a * dt
+static void EulerKernel(float* __restrict__ p, float* __restrict__ v, const float* __restrict__ f, const float* __restrict__ m, float dt, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++) {
+		p[i] = p[i] + v[i] * dt;
 		// F = ma <==> a = F/m
-		dst[j++] = (p->force.x / p->mass);
-		dst[j++] = (p->force.y / p->mass);
-		dst[j++] = (p->force.z / p->mass);
+		v[i] = v[i] * DRAG_COEFF + (f[i] / m[i]) * dt;
+	}
+}
+
+// v' = v * drag + a * dt, x' = x + v' * dt
+static void SemiImplicitKernel(float* __restrict__ p, float* __restrict__ v, const float* __restrict__ f, const float* __restrict__ m, float dt, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++) {
+		v[i] = v[i] * DRAG_COEFF + (f[i] / m[i]) * dt;
+		p[i] = p[i] + v[i] * dt;
+	}
+}
+
+// half a kick (of h = dt / 2) with the old forces, then the
+// whole drift
+static void VerletDriftKernel(float* __restrict__ p, float* __restrict__ v, const float* __restrict__ f, const float* __restrict__ m, float dt, float h, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++) {
+		v[i] = v[i] * DRAG_COEFF + (f[i] / m[i]) * h;
+		p[i] = p[i] + v[i] * dt;
+	}
+}
+
+// the other half of the kick, with the new forces
+static void VerletKickKernel(float* __restrict__ v, const float* __restrict__ f, const float* __restrict__ m, float h, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++) {
+		v[i] = v[i] + (f[i] / m[i]) * h;
+	}
+}
+
+static void RK4BeginKernel(const float* __restrict__ p, const float* __restrict__ v, const float* __restrict__ f, float* __restrict__ p0, float* __restrict__ v0, float* __restrict__ f0, float* __restrict__ sv, float* __restrict__ sa, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++) {
+		p0[i] = p[i];
+		v0[i] = v[i];
+		f0[i] = f[i];
+		sv[i] = 0.0f;
+		sa[i] = 0.0f;
+	}
+}
+
+// adds a stage's velocities and accelerations (weight w) to
+// the sums, then moves on to the start of the step plus h
+// times them, with the forces carried into the step
+static void RK4StageKernel(float* __restrict__ p, float* __restrict__ v, float* __restrict__ f, const float* __restrict__ p0, const float* __restrict__ v0, const float* __restrict__ f0, float* __restrict__ sv, float* __restrict__ sa, const float* __restrict__ m, float w, float h, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++) {
+		const float a = f[i] / m[i];
+
+		sv[i] = sv[i] + v[i] * w;
+		sa[i] = sa[i] + a * w;
+		p[i] = p0[i] + v[i] * h;
+		v[i] = v0[i] + a * h;
+		f[i] = f0[i];
+	}
+}
+
+// adds the last stage (weight w) and steps by s = dt / 6 times
+// the sums; its forces are carried into the next step
+static void RK4EndKernel(float* __restrict__ p, float* __restrict__ v, const float* __restrict__ f, const float* __restrict__ p0, const float* __restrict__ v0, const float* __restrict__ sv, const float* __restrict__ sa, const float* __restrict__ m, float w, float s, unsigned int n) {
+	for (unsigned int i = 0; i < n; i++) {
+		const float a = f[i] / m[i];
+
+		p[i] = p0[i] + (sv[i] + v[i] * w) * s;
+		v[i] = v0[i] * DRAG_COEFF + (sa[i] + a * w) * s;
+	}
+}
+
+void CParticleSystem::EulerPass(float dt, unsigned int i0, unsigned int i1) {
+	const unsigned int n = ParticleArrays::GetPaddedSize(i1 - i0);
+
+	for (unsigned int c = 0; c < 3; c++) {
+		EulerKernel(arrays.GetPosData(c) + i0, arrays.GetVelocityData(c) + i0, arrays.GetForceData(c) + i0, &arrays.mass[i0], dt, n);
+	}
+}
+
+void CParticleSystem::SemiImplicitPass(float dt, unsigned int i0, unsigned int i1) {
+	const unsigned int n = ParticleArrays::GetPaddedSize(i1 - i0);
+
+	for (unsigned int c = 0; c < 3; c++) {
+		SemiImplicitKernel(arrays.GetPosData(c) + i0, arrays.GetVelocityData(c) + i0, arrays.GetForceData(c) + i0, &arrays.mass[i0], dt, n);
+	}
+}
+
+void CParticleSystem::VerletDriftPass(float dt, unsigned int i0, unsigned int i1) {
+	const unsigned int n = ParticleArrays::GetPaddedSize(i1 - i0);
+
+	for (unsigned int c = 0; c < 3; c++) {
+		VerletDriftKernel(arrays.GetPosData(c) + i0, arrays.GetVelocityData(c) + i0, arrays.GetForceData(c) + i0, &arrays.mass[i0], dt, dt * 0.5f, n);
+	}
+}
+
+void CParticleSystem::VerletKickPass(float dt, unsigned int i0, unsigned int i1) {
+	const unsigned int n = ParticleArrays::GetPaddedSize(i1 - i0);
+
+	for (unsigned int c = 0; c < 3; c++) {
+		VerletKickKernel(arrays.GetVelocityData(c) + i0, arrays.GetForceData(c) + i0, &arrays.mass[i0], dt * 0.5f, n);
 	}
 }
 
-void CParticleSystem::ScaleVector(std::vector<float> &v, float s) {
-	for (unsigned int i = 0; i < v.size(); i++) {
-		v[i] *= s;
+void CParticleSystem::RK4BeginPass(unsigned int i0, unsigned int i1) {
+	const unsigned int n = ParticleArrays::GetPaddedSize(i1 - i0);
+
+	for (unsigned int c = 0; c < 3; c++) {
+		RK4BeginKernel(
+			arrays.GetPosData(c) + i0, arrays.GetVelocityData(c) + i0, arrays.GetForceData(c) + i0,
+			&rk4.pos[c][i0], &rk4.vel[c][i0], &rk4.force[c][i0], &rk4.sumVel[c][i0], &rk4.sumAcc[c][i0], n
+		);
+	}
+}
+
+// the forces were just computed at the positions of <stage>
+void CParticleSystem::RK4StagePass(unsigned int stage, float dt, unsigned int i0, unsigned int i1) {
+	static const float weights[4] = {1.0f, 2.0f, 2.0f, 1.0f};
+	static const float offsets[4] = {0.5f, 0.5f, 1.0f, 0.0f};
+
+	const unsigned int n = ParticleArrays::GetPaddedSize(i1 - i0);
+
+	for (unsigned int c = 0; c < 3; c++) {
+		if (stage < 3) {
+			RK4StageKernel(
+				arrays.GetPosData(c) + i0, arrays.GetVelocityData(c) + i0, arrays.GetForceData(c) + i0,
+				&rk4.pos[c][i0], &rk4.vel[c][i0], &rk4.force[c][i0], &rk4.sumVel[c][i0], &rk4.sumAcc[c][i0],
+				&arrays.mass[i0], weights[stage], offsets[stage] * dt, n
+			);
+		} else {
+			RK4EndKernel(
+				arrays.GetPosData(c) + i0, arrays.GetVelocityData(c) + i0, arrays.GetForceData(c) + i0,
+				&rk4.pos[c][i0], &rk4.vel[c][i0], &rk4.sumVel[c][i0], &rk4.sumAcc[c][i0],
+				&arrays.mass[i0], weights[stage], dt / 6.0f, n
+			);
+		}
+	}
+
+	// the border force moves particles on to the slices of
+	// the positions it is evaluated at, but only the first
+	// stage's are ones the particles actually reach
+	if (stage == 0) {
+		std::copy(arrays.sliceIdx.begin() + i0, arrays.sliceIdx.begin() + i1, rk4.slice.begin() + i0);
+	} else {
+		std::copy(rk4.slice.begin() + i0, rk4.slice.begin() + i1, arrays.sliceIdx.begin() + i0);
+	}
+}
+
+
+
+void CParticleSystem::BenchmarkCellList(float cutoff, int maxParticles) {
+	// about 30 neighbours within the cutoff of each particle
+	const float density = 30.0f / ((4.0f / 3.0f) * PI * cutoff * cutoff * cutoff);
+
+	printf("[CParticleSystem::BenchmarkCellList] cutoff %.2f, %.1f particles per unit^3\n", cutoff, density);
+
+	for (int n = 1000; n <= maxParticles; n *= 10) {
+		CParticleSystem ps(n);
+
+		const float side = cbrtf(n / density);
+		unsigned int t0 = 0;
+		unsigned int tCells = 0;
+		unsigned int tBuild = 0;
+
+		for (int i = 0; i < n; i++) {
+			ps.arrays.SetPos(i, vec3(rng.RandFloat(side), rng.RandFloat(side), rng.RandFloat(side)));
+		}
+
+		ps.SetInteractionCutoff(cutoff);
+
+		t0 = SDL_GetTicks();
+		ps.ComputePairForces();
+		tCells = SDL_GetTicks() - t0;
+
+		t0 = SDL_GetTicks();
+		ps.cellList.Build(ps.positions, cutoff);
+		tBuild = SDL_GetTicks() - t0;
+
+		printf("\t%7d particles: cell list %u msecs (rebuild %u msecs, %u cells)", n, tCells, tBuild, ps.cellList.GetNumCells());
+
+		if (n <= 10000) {
+			t0 = SDL_GetTicks();
+
+			for (int i = 0; i < n; i++) {
+				vec3 f = NVec;
+
+				for (int j = 0; j < n; j++) {
+					if (j == i) continue;
+					f += PairForce(ps.positions[i] - ps.positions[j], ps.radii[i], ps.radii[j]);
+				}
+
+				ps.pairForces[i] = f;
+			}
+
+			printf(", all pairs %u msecs", SDL_GetTicks() - t0);
+		}
+
+		printf("\n");
+	}
+}
+
+void CParticleSystem::BenchmarkBarnesHut(int n) {
+	static const float thetas[] = {0.2f, 0.35f, 0.5f, 0.7f, 1.0f};
+	static const int numThetas = sizeof(thetas) / sizeof(thetas[0]);
+
+	// same density as a tightly packed group in the tunnel
+	const float side = cbrtf(float(n)) * 2.0f;
+
+	CParticleSystem ps(n);
+	std::vector<vec3> exact(n);
+
+	for (int i = 0; i < n; i++) {
+		ps.arrays.SetPos(i, vec3(rng.RandFloat(side), rng.RandFloat(side), rng.RandFloat(side)));
+
+		ps.positions[i] = ps.arrays.GetPos(i);
+		ps.radii[i] = ps.arrays.radius[i];
+	}
+
+	unsigned int t0 = SDL_GetTicks();
+
+	for (int i = 0; i < n; i++) {
+		vec3 f = NVec;
+
+		for (int j = 0; j < n; j++) {
+			if (j == i) continue;
+			f += PairForce(ps.positions[i] - ps.positions[j], ps.radii[i], ps.radii[j]);
+		}
+
+		exact[i] = f;
+	}
+
+	printf("[CParticleSystem::BenchmarkBarnesHut] %d particles, all pairs %u msecs\n", n, SDL_GetTicks() - t0);
+
+	for (int k = 0; k < numThetas; k++) {
+		ps.SetBarnesHut(thetas[k]);
+
+		t0 = SDL_GetTicks();
+		ps.barnesHut.Build(ps.positions, ps.radii);
+		const unsigned int tBuild = SDL_GetTicks() - t0;
+
+		t0 = SDL_GetTicks();
+		ps.barnesHut.ComputeForces(ps.pairForces, PairForce);
+		const unsigned int tForces = SDL_GetTicks() - t0;
+
+		// relative to the magnitude of the exact force (which
+		// is never close to 0 for a particle in a dense cloud)
+		float maxErr = 0.0f;
+		double sumErr = 0.0;
+
+		for (int i = 0; i < n; i++) {
+			const float err = (ps.pairForces[i] - exact[i]).len3D() / std::max(exact[i].len3D(), EPSILON);
+
+			maxErr = std::max(maxErr, err);
+			sumErr += err;
+		}
+
+		printf("\ttheta %.2f: build %u msecs, forces %u msecs, %u nodes, error mean %.2e max %.2e\n",
+			thetas[k], tBuild, tForces, ps.barnesHut.GetNumNodes(), sumErr / n, maxErr);
 	}
 }
 
-void CParticleSystem::AddVectors(const std::vector<float> &v1, const std::vector<float> &v2, std::vector<float> &v3) {
-	for (unsigned int i = 0; i < v1.size(); i++)
-		v3[i] = v1[i] + v2[i];
+void CParticleSystem::BenchmarkPairKernel(int n) {
+	const float side = cbrtf(float(n)) * 0.5f;
+	const int numKernels = PAIR_KERNEL_AUTO;
+	const int numReps = std::max(1, 20000000 / (n * n));
+
+	CParticleSystem ps(n);
+	std::vector<vec3> exact(n);
+
+	// a dense cloud, so z covers everything from the clamp
+	// (overlapping particles) up to the cloud's diameter
+	for (int i = 0; i < n; i++) {
+		ps.arrays.SetPos(i, vec3(rng.RandFloat(side), rng.RandFloat(side), rng.RandFloat(side)));
+	}
+
+	printf("[CParticleSystem::BenchmarkPairKernel] %d particles, %d repetitions\n", n, numReps);
+
+	for (int t = 0; t < numKernels; t++) {
+		if (!CPairKernel::IsSupported(pairKernelType(t))) {
+			printf("\t%-8s not supported\n", CPairKernel::GetName(pairKernelType(t)));
+			continue;
+		}
+
+		CPairKernel kernel(pairForceParams, pairKernelType(t));
+		std::vector<vec3> forces(n);
+
+		const ParticleArrays& a = ps.arrays;
+		unsigned int t0 = SDL_GetTicks();
+
+		for (int k = 0; k < numReps; k++) {
+			for (int i = 0; i < n; i++) {
+				forces[i] = NVec;
+				kernel.AddForces(&a.posX[0], &a.posY[0], &a.posZ[0], &a.radius[0], n, i, forces[i]);
+			}
+		}
+
+		const unsigned int dt = std::max(SDL_GetTicks() - t0, 1u);
+		const double pairsPerSec = (double(n) * (n - 1) * numReps) / (dt * 0.001);
+
+		// the same forces from every pair once (the way the
+		// system sums them), in ordered pairs per second too
+		ps.SetPairKernel(pairKernelType(t));
+		t0 = SDL_GetTicks();
+
+		for (int k = 0; k < numReps; k++) {
+			ps.ComputePairForces();
+		}
+
+		const unsigned int dtSym = std::max(SDL_GetTicks() - t0, 1u);
+		const double symPairsPerSec = (double(n) * (n - 1) * numReps) / (dtSym * 0.001);
+
+		if (t == PAIR_KERNEL_SCALAR) {
+			exact = forces;
+		}
+
+		float maxErr = 0.0f;
+		float maxSymErr = 0.0f;
+
+		for (int i = 0; i < n; i++) {
+			maxErr = std::max(maxErr, (forces[i] - exact[i]).len3D() / std::max(exact[i].len3D(), EPSILON));
+			maxSymErr = std::max(maxSymErr, (ps.pairForces[i] - exact[i]).len3D() / std::max(exact[i].len3D(), EPSILON));
+		}
+
+		printf("\t%-8s %7.1f M pairs/sec (symmetric %7.1f), force error max %.2e (symmetric %.2e), z^-%.1f error max %.2e\n",
+			CPairKernel::GetName(pairKernelType(t)), pairsPerSec * 1e-6, symPairsPerSec * 1e-6, maxErr, maxSymErr,
+			S2, CPairKernel::MeasurePowError(pairKernelType(t), S2, EPSILON, 1e4f, 1 << 20));
+	}
 }
 
-void CParticleSystem::GetState(std::vector<float>& v) {
-	for (int i = 0, j = 0; i < numParticles; i++) {
-		Particle* p = GetParticle(i);
-		v[j++] = p->pos.x;
-		v[j++] = p->pos.y;
-		v[j++] = p->pos.z;
-		v[j++] = p->velocity.x * DRAG_COEFF;
-		v[j++] = p->velocity.y * DRAG_COEFF;
-		v[j++] = p->velocity.z * DRAG_COEFF;
+void CParticleSystem::BenchmarkThreads(CPathFinder* pf, int n, int numSteps, unsigned int maxThreads) {
+	if (pf->tunnel.empty()) {
+		printf("[CParticleSystem::BenchmarkThreads] no tunnel to run in\n");
+		return;
+	}
+
+	// spread over the first slice (InitParticles would stack
+	// all layers from the fifth one on at its center)
+	const BoundingCircle& bc = pf->tunnel.front();
+	std::vector<vec3> starts(n);
+
+	for (int i = 0; i < n; i++) {
+		const float a = DTOR(rng.RandFloat(360.0f));
+		const float r = bc.radius * 0.8f * sqrtf(rng.RandFloat());
+
+		starts[i] = bc.m.Mul(vec3(r * cosf(a), r * sinf(a), 0.0f));
+	}
+
+	CParticleSystem ps(n);
+	std::vector<vec3> ends(n);
+	unsigned int baseTime = 1;
+
+	printf("[CParticleSystem::BenchmarkThreads] %d particles, %d steps, %u hardware threads\n", n, numSteps, std::thread::hardware_concurrency());
+
+	for (unsigned int t = 1; t <= maxThreads; t <<= 1) {
+		for (int i = 0; i < n; i++) {
+			ps.arrays.SetPos(i, starts[i]);
+			ps.arrays.SetVelocity(i, NVec);
+			ps.arrays.SetForce(i, NVec);
+			ps.arrays.sliceIdx[i] = 0;
+			ps.sparticles[i] = i;
+		}
+
+		ps.SetNumThreads(t);
+		ps.inited = true;
+
+		const unsigned int t0 = SDL_GetTicks();
+
+		for (int k = 0; k < numSteps; k++) {
+			ps.Update(0.01f, pf);
+		}
+
+		const unsigned int dt = SDL_GetTicks() - t0;
+
+		// chunks are the same for every t, so are the results
+		bool same = true;
+
+		for (int i = 0; i < n; i++) {
+			const vec3 p = ps.arrays.GetPos(i);
+
+			if (t == 1) {
+				ends[i] = p;
+			} else {
+				same = same && (p.x == ends[i].x && p.y == ends[i].y && p.z == ends[i].z);
+			}
+		}
+
+		if (t == 1) {
+			baseTime = std::max(dt, 1U);
+		}
+
+		printf("\t%2u threads: %5u msecs (speed-up %.2f), %s\n",
+			t, dt, float(baseTime) / std::max(dt, 1U), (same? "same positions": "positions differ"));
 	}
 }
 
-void CParticleSystem::SetState(std::vector<float>& v) {
-	for (int i = 0, j = 0; i < numParticles; i++) {
-		Particle* p = GetParticle(i);
-		p->pos.x = v[j++];
-		p->pos.y = v[j++];
-		p->pos.z = v[j++];
-		p->velocity.x = v[j++];
-		p->velocity.y = v[j++];
-		p->velocity.z = v[j++];
+void CParticleSystem::BenchmarkIntegrators(int n, int numSteps) {
+	// floats read plus floats written per particle and step
+	static const unsigned int floatsMoved[NUM_INTEGRATORS] = {
+		16,                   // p v f m -> p v
+		16,                   // dito
+		16 + 10,              // drift, then kick (v f m -> v)
+		24 + 3 * 37 + 25,     // begin, 3 stages, end
+	};
+
+	CParticleSystem ps(n);
+
+	for (int i = 0; i < n; i++) {
+		ps.arrays.SetPos(i, vec3(rng.RandFloat(), rng.RandFloat(), rng.RandFloat()));
+		ps.arrays.SetVelocity(i, vec3(rng.RandFloat(), rng.RandFloat(), rng.RandFloat()));
+		ps.arrays.SetForce(i, vec3(rng.RandFloat(), rng.RandFloat(), rng.RandFloat()));
+	}
+
+	// not part of what is timed
+	ps.ResizeRK4();
+
+	printf("[CParticleSystem::BenchmarkIntegrators] %d particles, %d steps, %u threads (forces fixed)\n", n, numSteps, ps.GetNumThreads());
+
+	{
+		// the step Update made before: derivative, scale,
+		// gather and add into component-major copies, scatter
+		std::vector<float> temp1(n * 6);
+		std::vector<float> temp2(n * 6);
+
+		const unsigned int t0 = SDL_GetTicks();
+
+		for (int k = 0; k < numSteps; k++) {
+			ParticleArrays& a = ps.arrays;
+
+			for (int i = 0; i < n; i++) {
+				temp1[        i] = a.velX[i];
+				temp1[    n + i] = a.velY[i];
+				temp1[2 * n + i] = a.velZ[i];
+				temp1[3 * n + i] = a.forceX[i] / a.mass[i];
+				temp1[4 * n + i] = a.forceY[i] / a.mass[i];
+				temp1[5 * n + i] = a.forceZ[i] / a.mass[i];
+			}
+			for (int i = 0; i < n * 6; i++) {
+				temp1[i] *= 0.01f;
+			}
+			for (int i = 0; i < n; i++) {
+				temp2[        i] = a.posX[i];
+				temp2[    n + i] = a.posY[i];
+				temp2[2 * n + i] = a.posZ[i];
+				temp2[3 * n + i] = a.velX[i] * DRAG_COEFF;
+				temp2[4 * n + i] = a.velY[i] * DRAG_COEFF;
+				temp2[5 * n + i] = a.velZ[i] * DRAG_COEFF;
+			}
+			for (int i = 0; i < n * 6; i++) {
+				temp2[i] = temp1[i] + temp2[i];
+			}
+			for (int i = 0; i < n; i++) {
+				a.posX[i] = temp2[        i];
+				a.posY[i] = temp2[    n + i];
+				a.posZ[i] = temp2[2 * n + i];
+				a.velX[i] = temp2[3 * n + i];
+				a.velY[i] = temp2[4 * n + i];
+				a.velZ[i] = temp2[5 * n + i];
+			}
+		}
+
+		const unsigned int dt = std::max(SDL_GetTicks() - t0, 1u);
+		// 13 + 12 + 12 + 18 + 12 floats per particle
+		const double bytes = 67.0 * sizeof(float) * n * numSteps;
+
+		printf("\t%-20s %5u msecs, %6.1f M particles/sec, %5.1f GB/sec\n", "copying Euler",
+			dt, (double(n) * numSteps) / (dt * 1000.0), bytes / (dt * 1e6));
+	}
+
+	for (int t = 0; t < NUM_INTEGRATORS; t++) {
+		const unsigned int t0 = SDL_GetTicks();
+
+		for (int k = 0; k < numSteps; k++) {
+			switch (t) {
+				case INTEGRATOR_EULER: {
+					ps.ParallelFor(n, [&](unsigned int i0, unsigned int i1) { ps.EulerPass(0.01f, i0, i1); });
+				} break;
+				case INTEGRATOR_SEMI_IMPLICIT: {
+					ps.ParallelFor(n, [&](unsigned int i0, unsigned int i1) { ps.SemiImplicitPass(0.01f, i0, i1); });
+				} break;
+				case INTEGRATOR_VERLET: {
+					ps.ParallelFor(n, [&](unsigned int i0, unsigned int i1) { ps.VerletDriftPass(0.01f, i0, i1); });
+					ps.ParallelFor(n, [&](unsigned int i0, unsigned int i1) { ps.VerletKickPass(0.01f, i0, i1); });
+				} break;
+				case INTEGRATOR_RK4: {
+					ps.ParallelFor(n, [&](unsigned int i0, unsigned int i1) { ps.RK4BeginPass(i0, i1); });
+
+					for (unsigned int stage = 0; stage < 4; stage++) {
+						ps.ParallelFor(n, [&](unsigned int i0, unsigned int i1) { ps.RK4StagePass(stage, 0.01f, i0, i1); });
+					}
+				} break;
+			}
+		}
+
+		const unsigned int dt = std::max(SDL_GetTicks() - t0, 1u);
+		const double bytes = double(floatsMoved[t]) * sizeof(float) * n * numSteps;
+
+		printf("\t%-20s %5u msecs, %6.1f M particles/sec, %5.1f GB/sec\n", GetIntegratorName(integratorType(t)),
+			dt, (double(n) * numSteps) / (dt * 1000.0), bytes / (dt * 1e6));
 	}
 }
@@ -2,19 +2,41 @@
 #define PARTICLESYSTEM_HPP
 
 #include <vector>
+#include <algorithm>
 
 #include "../../Math/matrix44.hpp"
 #include "../../Math/vec3.hpp"
-class Particle;
+#include "../../System/ThreadPool.hpp"
+#include "./CellList.hpp"
+#include "./BarnesHut.hpp"
+#include "./Particle.hpp"
+#include "./ParticlePool.hpp"
+#include "./PairKernel.hpp"
 class CPathFinder;
 
+// particles per chunk of the per-particle work of a step
+#define PARTICLES_PER_CHUNK 256
+
+// how Update advances the particles by a step; every one
+// damps the velocities by DRAG_COEFF once per step
+enum integratorType {
+	INTEGRATOR_EULER         = 0,
+	INTEGRATOR_SEMI_IMPLICIT = 1,
+	INTEGRATOR_VERLET        = 2,
+	INTEGRATOR_RK4           = 3,
+	NUM_INTEGRATORS          = 4,
+};
+
 class CParticleSystem {
 	public:
-		CParticleSystem(int numParticles);
+		// room for <maxParticles> (0: just the first ones), all
+		// allocated up front
+		CParticleSystem(int numParticles, int maxParticles = 0);
 		~CParticleSystem();
 
-		Particle* GetParticle(int i);
+		Particle GetParticle(int i) { return Particle(&arrays, i); }
 		int numParticles;
+		int GetMaxParticles() const { return particlePool.GetCapacity(); }
 
 		void Reset() { inited = false; }
 		bool IsInited() const { return inited; }
@@ -22,23 +44,163 @@ class CParticleSystem {
 		void Update(float deltaT, CPathFinder* pf);
 		void CreateParticles();
 		void InitParticles(CPathFinder* pf);
-		void AddParticle(const vec3& pos, float radius);
+		// O(1) either way; a removed particle's place is taken
+		// by the last one, so positions change but handles do
+		// not (PARTICLE_NO_HANDLE: the system is full)
+		ParticleHandle AddParticle(const vec3& pos, float radius);
+		bool RemoveParticle(ParticleHandle h);
+		// -1 if <h> is stale
+		int GetParticleIndex(ParticleHandle h) const { const unsigned int i = particlePool.GetIndex(h); return ((i == PARTICLE_NO_INDEX)? -1: int(i)); }
+		ParticleHandle GetParticleHandle(int i) const { return particlePool.GetHandle(i); }
+		// particles per second that stream in over the first
+		// slice of the tunnel (while there is room), and leave
+		// it at the last one (0: none, and those at the end of
+		// the tunnel stay)
+		void SetEmitRate(float rate) { emitRate = rate; }
+		float GetEmitRate() const { return emitRate; }
 		void SetAttractionPoint(float x, float y);
 
+		// particles further apart than <r> no longer repel each
+		// other, which lets a cell list find the pairs that do
+		// (0: every pair interacts, found by brute force)
+		void SetInteractionCutoff(float r) { cutoff = r; }
+		float GetInteractionCutoff() const { return cutoff; }
+		// sums the pair forces over a Barnes-Hut octree with
+		// opening angle <theta> (0: exact, as set above); the
+		// far field is approximated, the near field is not
+		void SetBarnesHut(float theta) { barnesHutTheta = theta; barnesHut.SetTheta(theta); }
+		float GetBarnesHut() const { return barnesHutTheta; }
+		// the kernel the all-pairs forces are summed with (the
+		// vector ones approximate the powers, see CPairKernel)
+		void SetPairKernel(pairKernelType t) { pairKernel.SetType(t); }
+		pairKernelType GetPairKernel() const { return pairKernel.GetType(); }
+		// threads a step runs on (0: one per hardware thread);
+		// the chunks the work is split into do not depend on
+		// the number, so neither do the results
+		void SetNumThreads(unsigned int n) { pool.SetNumThreads(n); }
+		unsigned int GetNumThreads() const { return pool.GetNumThreads(); }
+		// (for other work of the sim's to share)
+		CThreadPool* GetThreadPool() { return &pool; }
+		// explicit Euler by default; velocity Verlet takes its
+		// first half-kick from the forces of the step before,
+		// RK4 computes the forces four times a step
+		void SetIntegrator(integratorType t) { integrator = t; }
+		integratorType GetIntegrator() const { return integrator; }
+		static const char* GetIntegratorName(integratorType t);
+
+		// times the pair forces of 1k, 10k, ... up to <maxParticles>
+		// random particles at constant density, with and (up to
+		// 10k) without a cell list
+		static void BenchmarkCellList(float cutoff, int maxParticles);
+		// time and force error (relative to the exact sums) of
+		// the octree for a few opening angles, on <numParticles>
+		// random particles
+		static void BenchmarkBarnesHut(int numParticles);
+		// pair interactions per second of every kernel the CPU
+		// supports, and their errors against the scalar one
+		static void BenchmarkPairKernel(int numParticles);
+		// time of <numSteps> steps of <numParticles> particles
+		// in pf's tunnel on 1, 2, 4, ... <maxThreads> threads
+		static void BenchmarkThreads(CPathFinder* pf, int numParticles, int numSteps, unsigned int maxThreads);
+		// time and memory traffic of <numSteps> integration steps
+		// (with fixed forces) of <numParticles> particles for every
+		// integrator, and for the copying Euler step they replaced
+		static void BenchmarkIntegrators(int numParticles, int numSteps);
+
 	private:
-		std::vector<Particle*> particles;
-		std::vector<Particle*> sparticles;
-		std::vector<float> temp1, temp2;
+		ParticleArrays arrays;
+		// particle indices by descending slice, the lowest and
+		// highest slice (as of the start of the step) and space
+		// for SortBySlice
+		std::vector<unsigned int> sparticles;
+		std::vector<unsigned int> sortScratch;
+		std::vector<unsigned int> sliceCounts;
+		unsigned int minSlice;
+		unsigned int maxSlice;
+		// set when a removal left <sparticles> out of date
+		bool resort;
+		CParticlePool particlePool;
+		float emitRate;
+		// particles due but not emitted yet
+		float emitDebt;
 		vec3 attractionPoint;
 		bool inited;
 
+		float cutoff;
+		CCellList cellList;
+		float barnesHutTheta;
+		CBarnesHut barnesHut;
+		CPairKernel pairKernel;
+		CThreadPool pool;
+		integratorType integrator;
+
+		// RK4's start of the step (positions, velocities and the
+		// forces carried into it) and its weighted sums of the
+		// stages' velocities and accelerations, per component,
+		// plus the slices as of the first stage's forces
+		struct RK4State {
+			ParticleArray pos[3];
+			ParticleArray vel[3];
+			ParticleArray force[3];
+			ParticleArray sumVel[3];
+			ParticleArray sumAcc[3];
+			ParticleIndexArray slice;
+		};
+
+		RK4State rk4;
+
+		// every pair is evaluated once and its force added to
+		// one particle and subtracted from the other, by each
+		// chunk into a buffer of its own (padded like the
+		// particle arrays); the buffers are summed in order
+		//
+		// indices are particles (all pairs) or positions in cell
+		// order (cell list), the buffer holds those in [first,
+		// last) and element p - base belongs to p
+		struct ForceBuffer {
+			ParticleArray x, y, z;
+			unsigned int base, first, last;
+		};
+
+		std::vector<ForceBuffer> forceBuffers;
+		// the [first, last) indices whose pairs chunk c sums
+		std::vector<unsigned int> pairBounds;
+		// per-step copies of the particles' positions and radii
+		// (the cell list's input) and the pair forces summed up;
+		// sized to the particles, with room for the most
+		std::vector<vec3> positions;
+		std::vector<float> radii;
+		std::vector<vec3> pairForces;
+
+		void SortBySlice();
+		void RetireParticles(CPathFinder* pf);
+		void EmitParticles(CPathFinder* pf, float deltaT);
 		void ComputeForces(CPathFinder* pf);
-		vec3 ComputeBorderForce(CPathFinder* pf, Particle* p);
-		void GetDerivative(CPathFinder* pf, std::vector<float>& dst);
-		void ScaleVector(std::vector<float>& v, float s);
-		void AddVectors(const std::vector<float>& v1, const std::vector<float>& v2, std::vector<float>& v3);
-		void GetState(std::vector<float>& v);
-		void SetState(std::vector<float>& v);
+		void ComputePairForces();
+		void SumPairForces(unsigned int c);
+		template<typename F> void ParallelFor(unsigned int n, F f);
+		vec3 ComputeBorderForce(CPathFinder* pf, int i);
+
+		// the integrators' passes over the particles [i0, i1),
+		// in place; they run on to the end of the line of the
+		// padded arrays (whose padding stays at rest), so the
+		// loops vectorize without a scalar tail
+		void EulerPass(float dt, unsigned int i0, unsigned int i1);
+		void SemiImplicitPass(float dt, unsigned int i0, unsigned int i1);
+		void VerletDriftPass(float dt, unsigned int i0, unsigned int i1);
+		void VerletKickPass(float dt, unsigned int i0, unsigned int i1);
+		// (sized like the arrays on RK4's first step)
+		void ResizeRK4();
+		void RK4BeginPass(unsigned int i0, unsigned int i1);
+		void RK4StagePass(unsigned int stage, float dt, unsigned int i0, unsigned int i1);
 };
 
+// calls f(i0, i1) for consecutive ranges of PARTICLES_PER_CHUNK
+// of [0, n) on the pool's threads
+template<typename F> void CParticleSystem::ParallelFor(unsigned int n, F f) {
+	pool.Run((n + PARTICLES_PER_CHUNK - 1) / PARTICLES_PER_CHUNK, [&](unsigned int c) {
+		f(c * PARTICLES_PER_CHUNK, std::min((c + 1) * PARTICLES_PER_CHUNK, n));
+	});
+}
+
 #endif
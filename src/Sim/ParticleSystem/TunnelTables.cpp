@@ -0,0 +1,64 @@
+#include "./TunnelTables.hpp"
+
+void TunnelTables::Build(const std::vector<BoundingCircle>& tunnel) {
+	numSlices = tunnel.size();
+	numSegments = tunnel.empty()? 0: tunnel[0].numSegments;
+	segmentAngle = tunnel.empty()? 0.0f: tunnel[0].segmentAngle;
+
+	std::vector<float>* sliceComps[] = {
+		&normalX, &normalY, &normalZ, &planeOffset,
+		&invX[0], &invX[1], &invX[2], &invX[3],
+		&invY[0], &invY[1], &invY[2], &invY[3],
+		&radius, &axialX, &axialY, &axialZ,
+	};
+	std::vector<float>* segComps[] = {
+		&segNormalX, &segNormalY, &segNormalZ,
+		&segX, &segY, &segDX, &segDY, &segLength,
+	};
+
+	for (unsigned int c = 0; c < sizeof(sliceComps) / sizeof(sliceComps[0]); c++) {
+		sliceComps[c]->resize(numSlices);
+	}
+	for (unsigned int c = 0; c < sizeof(segComps) / sizeof(segComps[0]); c++) {
+		segComps[c]->resize(numSlices * numSegments);
+	}
+
+	for (unsigned int s = 0; s < numSlices; s++) {
+		const BoundingCircle& bcm = tunnel[s];
+		const BoundingCircle& bcn = tunnel[std::min(s + 1, numSlices - 1)];
+		const vec3 normalM = (bcm.m).GetDir(2);
+		const vec3 normalN = (bcn.m).GetDir(2);
+		const vec3 axial = (normalM + normalN) * 3.0f;
+
+		normalX[s] = normalM.x;
+		normalY[s] = normalM.y;
+		normalZ[s] = normalM.z;
+		planeOffset[s] = normalM.dot3D((bcm.m).GetDir(3));
+
+		for (unsigned int j = 0; j < 4; j++) {
+			invX[j][s] = bcm.n[j * 4 + 0];
+			invY[j][s] = bcm.n[j * 4 + 1];
+		}
+
+		radius[s] = bcm.radius;
+		axialX[s] = axial.x;
+		axialY[s] = axial.y;
+		axialZ[s] = axial.z;
+
+		for (int i = 0; i < numSegments; i++) {
+			const unsigned int k = s * numSegments + i;
+			const vec3 nv = bcm.GetWorldSegmentNormal(i);
+			const vec3& v1 = bcm.vertices[i];
+			const vec3& v2 = bcm.vertices[(i + 1) % numSegments];
+
+			segNormalX[k] = nv.x;
+			segNormalY[k] = nv.y;
+			segNormalZ[k] = nv.z;
+			segX[k] = v1.x;
+			segY[k] = v1.y;
+			segDX[k] = v2.x - v1.x;
+			segDY[k] = v2.y - v1.y;
+			segLength[k] = sqrtf((segDX[k] * segDX[k]) + (segDY[k] * segDY[k])) + 0.1f;
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef TUNNELTABLES_HPP
+#define TUNNELTABLES_HPP
+
+#include <vector>
+#include <algorithm>
+
+#include "../../Math/vec3.hpp"
+#include "./BoundingCircle.hpp"
+
+// what the border force needs of every slice of a tunnel,
+// one array per component, worked out once per tunnel
+// rather than per particle and step from the slices'
+// matrices (the results are the same as BoundingCircle's)
+struct TunnelTables {
+	TunnelTables(): numSlices(0), numSegments(0), segmentAngle(0.0f) {}
+
+	void Build(const std::vector<BoundingCircle>& tunnel);
+	void Clear() { Build(std::vector<BoundingCircle>()); }
+
+	// signed distance of <pos> in front of slice <s>'s plane
+	// (negative once past it)
+	float GetPlaneDistance(unsigned int s, const vec3& pos) const {
+		return (planeOffset[s] - vec3(normalX[s], normalY[s], normalZ[s]).dot3D(pos));
+	}
+
+	// the force slice <s>'s segments exert on <pos> (as the
+	// slice's GetForce on its GetParticleInvPos)
+	vec3 GetSliceForce(unsigned int s, const vec3& pos) const {
+		const float x = pos.x * invX[0][s] + pos.y * invX[1][s] + pos.z * invX[2][s] + invX[3][s];
+		const float y = pos.x * invY[0][s] + pos.y * invY[1][s] + pos.z * invY[2][s] + invY[3][s];
+		const float r = radius[s];
+
+		if ((x * x + y * y) > (r * r)) {
+			return NVec;
+		}
+
+		// 360 (an angle just below 0 rounded up) is in the last
+		const int seg = std::min(int(BoundingCircle::GetAngle(x, y) / segmentAngle), numSegments - 1);
+		const unsigned int k = s * numSegments + seg;
+
+		const float nn = fabsf(segDX[k] * (segY[k] - y) - (segX[k] - x) * segDY[k]);
+		const float dist = nn / segLength[k];
+		const float scalar = (r * 2.0f) / (dist + 0.1f);
+
+		return (vec3(segNormalX[k], segNormalY[k], segNormalZ[k]) * scalar);
+	}
+
+	// the pull along the tunnel at slice <s>: the sum of its
+	// normal and the next slice's (its own for the last one)
+	// times 3
+	vec3 GetAxialForce(unsigned int s) const {
+		return vec3(axialX[s], axialY[s], axialZ[s]);
+	}
+
+	unsigned int numSlices;
+	int numSegments;
+	float segmentAngle;
+
+	// per slice: the normal of its plane, the plane's offset
+	// (normal . origin), the rows of the inverse transform
+	// that give local x and y, its radius and axial force
+	std::vector<float> normalX, normalY, normalZ;
+	std::vector<float> planeOffset;
+	std::vector<float> invX[4];
+	std::vector<float> invY[4];
+	std::vector<float> radius;
+	std::vector<float> axialX, axialY, axialZ;
+
+	// per segment (element s * numSegments + i is segment i
+	// of slice s): its world-space normal, first vertex, edge
+	// and edge length (plus 0.1) in slice-local space
+	std::vector<float> segNormalX, segNormalY, segNormalZ;
+	std::vector<float> segX, segY;
+	std::vector<float> segDX, segDY;
+	std::vector<float> segLength;
+};
+
+#endif
@@ -1,69 +1,147 @@
 #include "AAStar.hpp"
 
+#include <cstdio>
+
 void AAStar::init() {
 	/* Reset the open and closed "lists" */
 	for (unsigned int i = 0; i < visited.size(); i++)
 		visited[i]->closed = visited[i]-> open = false;
 
-	visited.clear();
-	history.clear();
+	/* Size the lists like the last search needed them (it
+	   pushed numOpened entries at most), so none regrows */
+	const unsigned int numVisited = visited.size();
+	const unsigned int numOpened = stats.numOpened;
+
+	trace.Begin();
+	stats.Clear();
+
+	/* Let go of the last search's memory, then rewind the arena */
+	visited = NodeList(&searchArena);
+	succs = NodeList(&searchArena);
+	open = OpenQueue(AOpenEntryCmp(tieBreak), OpenList(&searchArena));
 
-	/* Pop the queue */
-	while (!open.empty()) {
-		open.pop();
+	searchArena.Reset();
+
+	OpenList openList(&searchArena);
+	openList.reserve(numOpened);
+	visited.reserve(numVisited);
+	succs.reserve(26);
+
+	/* (the tie-breaking policy might have changed) */
+	open = OpenQueue(AOpenEntryCmp(tieBreak), std::move(openList));
+}
+
+bool AAStar::findPath(std::vector<ANode*>& path) {
+	searchState s;
+
+	beginSearch();
+
+	while ((s = searchStep(path)) == SEARCH_RUNNING) {
 	}
+
+	return (s == SEARCH_FOUND);
 }
 
-void AAStar::findPath(std::vector<ANode*>& path) {
-	float c;
-	ANode *x, *y;
+SearchTask AAStar::findPathTask(std::vector<ANode*>& path, SearchBudget budget) {
+	SearchSlice slice(budget);
+	searchState s;
+
+	beginSearch();
+
+	while ((s = searchStep(path)) == SEARCH_RUNNING) {
+		if (slice.Expired(stats.numExpanded)) {
+			co_yield stats.numExpanded;
+			slice.Begin(stats.numExpanded);
+		}
+	}
 
+	co_return (s == SEARCH_FOUND);
+}
+
+void AAStar::beginSearch() {
 	init();
 
-	printf("Pathfinding...");
-	open.push(start);
+	if (verbose)
+		printf("Pathfinding...");
+
+	start->g = 0.0f;
+	start->h = (start->w * goalHeuristic(start));
+	open.push(AOpenEntry(start));
 	start->open = true;
 	visited.push_back(start);
+	stats.numOpened++;
+}
 
-	while (!open.empty()) {
-		x = open.top(); open.pop();
-		x->open = false;
+searchState AAStar::searchStep(std::vector<ANode*>& path) {
+	float c;
+	ANode *x, *y;
+
+	if (open.empty()) {
+		if (verbose)
+			printf("[failed] (%u expanded, %u opened)\n", stats.numExpanded, stats.numOpened);
+
+		return SEARCH_FAILED;
+	}
+
+	const AOpenEntry e = open.top(); open.pop();
+	x = e.node;
+
+	/* Skip entries superseded by a cheaper re-insertion */
+	if (x->closed || e.g > x->g) {
+		stats.numStale++;
+		return SEARCH_RUNNING;
+	}
+
+	x->open = false;
+
+	if (isGoal(x)) {
+		/* with multiple goals, the first one popped is the nearest */
+		goal = x;
+		tracePath(path);
+
+		if (verbose)
+			printf("[done] (%u expanded, %u opened, %u reopened)\n", stats.numExpanded, stats.numOpened, stats.numReopened);
 
-		if (x == goal) {
-			tracePath(path);
-			printf("[done]\n");
-			return;
+		return SEARCH_FOUND;
+	}
+
+	x->closed = true;
+	stats.numExpanded++;
+
+	succs.clear();
+	successors(x, succs);
+
+	for (unsigned int i = 0; i < succs.size(); i++) {
+		y = succs[i];
+		c = x->g + (y->w * heuristic(x, y));
+
+		if (y->open && c < y->g)
+			y->open = false;
+
+		/* Only happens with an admissable heuristic */
+		if (y->closed && c < y->g) {
+			y->closed = false;
+			stats.numReopened++;
 		}
 
-		x->closed = true;
-
-		successors(x, succs);
-		while (!succs.empty()) {
-			y = succs.front(); succs.pop();
-			c = x->g + (y->w * heuristic(x, y));
-
-			if (y->open && c < y->g)
-				y->open = false;
-
-			/* Only happens with an admissable heuristic */
-			if (y->closed && c < y->g)
-				y->closed = false;
-			
-			if (!y->open && !y->closed) {
-				y->g = (unsigned int) c;
-				y->parent = x;
-				y->h = (y->w * heuristic(y, goal));
-				open.push(y);
-				y->open = true;
-
-				visited.push_back(y);
-				history.push_back(y);
-				history.push_back(x);
-			}
+		if (!y->open && !y->closed) {
+			y->g = c;
+			y->parent = x;
+			y->h = (y->w * goalHeuristic(y));
+			open.push(AOpenEntry(y));
+			y->open = true;
+			stats.numOpened++;
+
+			visited.push_back(y);
+
+#if (SEARCH_TRACE == 1)
+			if (trace.IsOn())
+				trace.RecordOpen(y->id, x->id);
+#endif
 		}
 	}
 
-	printf("[failed]\n");
+	return SEARCH_RUNNING;
 }
 
 void AAStar::tracePath(std::vector<ANode*>& path) {
@@ -71,7 +149,12 @@ void AAStar::tracePath(std::vector<ANode*>& path) {
 
 	while (n != start) {
 		path.push_back(n);
-		history.push_back(n);
+
+#if (SEARCH_TRACE == 1)
+		if (trace.IsOn())
+			trace.RecordPath(n->id);
+#endif
+
 		n = n->parent;
 	}
 }
@@ -7,35 +7,99 @@
 #include <iterator>
 
 #include "ANode.hpp"
+#include "SearchTask.hpp"
+#include "SearchTrace.hpp"
+#include "MonotonicArena.hpp"
+
+// size (in bytes) of the arena search-task frames come from
+#define SEARCH_FRAME_ARENA_SIZE 4096
+// initial size (in bytes) of the arena a search's open list,
+// visited list and successors are allocated from
+#define SEARCH_ARENA_SIZE (64 * 1024)
+
+enum searchState {SEARCH_RUNNING, SEARCH_FOUND, SEARCH_FAILED};
 
 class AAStar {
+	public:
+		struct SearchStats {
+			SearchStats() { Clear(); }
+			void Clear() { numExpanded = numOpened = numReopened = numStale = 0; }
+
+			unsigned int numExpanded;	// nodes popped and expanded
+			unsigned int numOpened;		// pushes onto the open list
+			unsigned int numReopened;	// closed nodes reached again via a cheaper path
+			unsigned int numStale;		// outdated open-list entries that were skipped
+		};
+
+		typedef std::pmr::vector<ANode*> NodeList;
+
 	private:
+		typedef std::pmr::vector<AOpenEntry> OpenList;
+		typedef std::priority_queue<AOpenEntry, OpenList, AOpenEntryCmp> OpenQueue;
+
+		/* backs the containers below, rewound by every init() */
+		CMonotonicArena searchArena;
+
 		/* nodes visited during pathfinding */
-		std::vector<ANode*> visited;
+		NodeList visited;
 
 		/* priority queue of the open list */
-		std::priority_queue<ANode*, std::vector<ANode*, std::allocator<ANode*> >, ANode> open;
+		OpenQueue open;
 
-		/* successors stack */
-		std::queue<ANode*> succs;
+		/* successors of the node being expanded */
+		NodeList succs;
 
 		/* traces the path from the goal node through its parents */
 		void tracePath(std::vector<ANode*> &path);
 
+		tieBreakType tieBreak;
+		bool verbose;
+
+		CSearchArena frameArena;
+
 
 	protected:
+		AAStar():
+			searchArena(SEARCH_ARENA_SIZE),
+			visited(&searchArena),
+			open(AOpenEntryCmp(TIEBREAK_LARGEST_G), OpenList(&searchArena)),
+			succs(&searchArena),
+			tieBreak(TIEBREAK_LARGEST_G),
+			verbose(true),
+			frameArena(SEARCH_FRAME_ARENA_SIZE) {}
 		void init();
+
+		/* findPath() in pieces: beginSearch() followed by
+		   searchStep() until that stops returning RUNNING */
+		void beginSearch();
+		searchState searchStep(std::vector<ANode*> &path);
 		virtual ~AAStar() {};
 
-		virtual void successors(ANode *n, std::queue<ANode*> &succ) = 0;
+		virtual void successors(ANode *n, NodeList &succ) = 0;
 		virtual float heuristic(ANode *n1, ANode *n2) = 0;
 
+		/* searches with several goals override these two */
+		virtual bool isGoal(ANode *n) { return (n == goal); }
+		virtual float goalHeuristic(ANode *n) { return heuristic(n, goal); }
+
 	public:
-		std::vector<ANode*> history;
-		void findPath(std::vector<ANode*> &path);
+		/* nodes opened and traced, for visualization only */
+		CSearchTrace trace;
+		/* returns false if the goal could not be reached */
+		bool findPath(std::vector<ANode*> &path);
+		/* same as findPath, suspending whenever <budget> runs out */
+		SearchTask findPathTask(std::vector<ANode*> &path, SearchBudget budget);
+		CSearchArena* GetFrameArena() { return &frameArena; }
+		const CMonotonicArena* GetSearchArena() const { return &searchArena; }
+		void SetVerbose(bool b) { verbose = b; }
+		void SetTieBreakPolicy(tieBreakType t) { tieBreak = t; }
+		tieBreakType GetTieBreakPolicy() const { return tieBreak; }
+		const SearchStats& GetSearchStats() const { return stats; }
 		ANode* start;
 		ANode* goal;
 
+	private:
+		SearchStats stats;
 };
 
 #endif
@@ -1,13 +1,16 @@
 #ifndef ANODE_HPP
 #define ANODE_HPP
 
+// how to order open nodes whose f-costs are equal
+enum tieBreakType {TIEBREAK_NONE, TIEBREAK_LARGEST_G, TIEBREAK_SMALLEST_H};
+
 class ANode {
 	public:
-		ANode() {id = 0; g = 0; h = w = 0.0f; open = closed = false; }
+		ANode() {id = 0; g = h = w = 0.0f; open = closed = false; }
 		ANode(unsigned int id, float w) {
 			this->id		= id;
 			this->w			= w;
-			this->g			= 0;
+			this->g			= 0.0f;
 			this->h			= 0.0f;
 			this->open		= false;
 			this->closed	= false;
@@ -20,7 +23,7 @@ class ANode {
 
 		unsigned int id;
 
-		unsigned int g;
+		float g;
 		float h;
 		float w;
 
@@ -31,7 +34,7 @@ class ANode {
 		}
 
 		bool operator () (const ANode* a, const ANode* b) const {
-			return (float(a->g + a->h) > float(b->g + b->h));
+			return ((a->g + a->h) > (b->g + b->h));
 		}
 
 		bool operator == (const ANode* n) const {
@@ -43,4 +46,42 @@ class ANode {
 		}
 };
 
+// snapshot of a node's costs at the time it was pushed onto
+// the open list; the node itself can be re-pushed later with
+// a lower g (which must not disturb the heap ordering)
+struct AOpenEntry {
+	AOpenEntry(ANode* n = 0x0): node(n) {
+		g = (n != 0x0)? n->g: 0.0f;
+		h = (n != 0x0)? n->h: 0.0f;
+		f = g + h;
+	}
+
+	ANode* node;
+	float f;
+	float g;
+	float h;
+};
+
+struct AOpenEntryCmp {
+	AOpenEntryCmp(tieBreakType t = TIEBREAK_LARGEST_G): tieBreak(t) {}
+
+	// returns true if <a> should be expanded AFTER <b>
+	bool operator () (const AOpenEntry& a, const AOpenEntry& b) const {
+		if (a.f != b.f)
+			return (a.f > b.f);
+
+		switch (tieBreak) {
+			// deeper nodes are closer to the goal for equal f
+			case TIEBREAK_LARGEST_G:  { if (a.g != b.g) return (a.g < b.g); } break;
+			case TIEBREAK_SMALLEST_H: { if (a.h != b.h) return (a.h > b.h); } break;
+			default: {} break;
+		}
+
+		// last resort, keeps the expansion order deterministic
+		return (a.node->id > b.node->id);
+	}
+
+	tieBreakType tieBreak;
+};
+
 #endif
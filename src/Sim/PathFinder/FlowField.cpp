@@ -0,0 +1,425 @@
+#include <cmath>
+
+#include "./FlowField.hpp"
+#include "./PathFinder.hpp"
+#include "../../System/ScopedTimer.hpp"
+#include "../../System/ThreadPool.hpp"
+
+// frontiers smaller than this are not worth waking threads for
+#define FLOW_MIN_PARALLEL_CELLS 4096
+
+static const float FLOW_INF_COST = 1e30f;
+
+CFlowField::CFlowField(CPathFinder* pf) {
+	const vec3 size = pf->GetWorldSize();
+
+	this->pf = pf;
+	this->pool = 0x0;
+	this->X = int(size.x);
+	this->Y = int(size.y);
+	this->Z = int(size.z);
+
+	goalIdx = -1;
+	minRad = maxRad = 0.0f;
+	numOffsets = 0;
+	numThreads = 1;
+
+	weights.resize(X * Y * Z, -1.0f);
+	codes.resize(X * Y * Z, FLOW_NONE);
+
+	costs = new std::atomic<float>[X * Y * Z];
+	queued = new std::atomic<ubyte>[X * Y * Z];
+
+	for (int i = 0; i < X * Y * Z; i++) {
+		costs[i].store(FLOW_INF_COST);
+		queued[i].store(0);
+	}
+
+	// repaired on every edit from here on
+	pf->SetFlowField(this);
+}
+
+CFlowField::~CFlowField() {
+	if (pf->GetFlowField() == this) {
+		pf->SetFlowField(0x0);
+	}
+
+	delete[] costs; costs = 0x0;
+	delete[] queued; queued = 0x0;
+}
+
+
+template<typename F> void CFlowField::ParallelFor(unsigned int n, F f) const {
+	const unsigned int T = (n < FLOW_MIN_PARALLEL_CELLS)? 1: numThreads;
+
+	// chunk <t> is the contiguous range [n * t / T, n * (t + 1) / T),
+	// run on the pool's threads
+	if (pool == 0x0) {
+		for (unsigned int t = 0; t < T; t++) {
+			f(t, (n * t) / T, (n * (t + 1)) / T);
+		}
+	} else {
+		pool->Run(T, [&](unsigned int t) { f(t, (n * t) / T, (n * (t + 1)) / T); });
+	}
+}
+
+
+void CFlowField::Generate(int gx, int gy, int gz, float minRad, float maxRad, unsigned int numThreads) {
+	ScopedTimer t("CFlowField::Generate()");
+
+	this->numThreads = (numThreads == 0)? ((pool != 0x0)? pool->GetNumThreads(): 1): numThreads;
+
+	// use the same neighbourhood as the A* successors
+	numOffsets = 0;
+
+	for (int i = -1; i <= 1; i++) {
+		for (int j = -1; j <= 1; j++) {
+			for (int k = -1; k <= 1; k++) {
+				const int sqLen = (i * i) + (j * j) + (k * k);
+
+				if (sqLen == 0)
+					continue;
+				if (sqLen > 1 && pf->GetConnectivity() ==  6)
+					continue;
+				if (sqLen > 2 && pf->GetConnectivity() == 18)
+					continue;
+
+				offsets[numOffsets][0] = i;
+				offsets[numOffsets][1] = j;
+				offsets[numOffsets][2] = k;
+				lengths[numOffsets] = sqrtf(sqLen);
+				directions[numOffsets] = vec3(i, j, k).norm();
+				numOffsets++;
+			}
+		}
+	}
+
+	this->minRad = minRad;
+	this->maxRad = maxRad;
+
+	pf->GenerateSphereBlockOffsets(maxRad, sphereOffsets);
+	goalIdx = pf->id(gx, gy, gz);
+
+	std::vector<int> changed;
+	ComputeWeights(0, X - 1, 0, Y - 1, 0, Z - 1, changed);
+
+	for (int i = 0; i < X * Y * Z; i++) {
+		costs[i].store(FLOW_INF_COST);
+		queued[i].store(0);
+	}
+
+	costs[goalIdx].store(0.0f);
+
+	std::vector<int> frontier(1, goalIdx);
+	Propagate(frontier, 0x0);
+
+	ParallelFor(X * Y * Z, [this](unsigned int, unsigned int i0, unsigned int i1) {
+		ComputeDirectionsRange(i0, i1);
+	});
+}
+
+void CFlowField::UpdateBlock(int x, int y, int z) {
+	if (goalIdx < 0) {
+		return;
+	}
+
+	// a (un)blocked voxel changes the clearance of every
+	// voxel whose sphere of radius maxRad can contain it
+	const int R = int(ceilf(maxRad)) + 1;
+
+	std::vector<int> changed;
+	std::vector<int> invalid;
+	std::vector<int> frontier;
+	std::vector<int> touched;
+
+	ComputeWeights(
+		std::max(0, x - R), std::min(X - 1, x + R),
+		std::max(0, y - R), std::min(Y - 1, y + R),
+		std::max(0, z - R), std::min(Z - 1, z + R),
+		changed
+	);
+
+	if (changed.empty()) {
+		return;
+	}
+
+	// invalidate every voxel whose flow passes through a changed
+	// one, ie. the subtrees of the changed voxels in the field's
+	// goal-rooted tree (a voxel is a child of <idx> if its code
+	// points at <idx>)
+	for (unsigned int i = 0; i < changed.size(); i++) {
+		if (queued[changed[i]].exchange(1) == 0) {
+			invalid.push_back(changed[i]);
+		}
+	}
+
+	for (unsigned int i = 0; i < invalid.size(); i++) {
+		const int idx = invalid[i];
+		const Node& n = pf->map[idx];
+
+		for (int k = 0; k < numOffsets; k++) {
+			const int cx = n.x - offsets[k][0];
+			const int cy = n.y - offsets[k][1];
+			const int cz = n.z - offsets[k][2];
+
+			if (cx < 0 || cx >= X || cy < 0 || cy >= Y || cz < 0 || cz >= Z)
+				continue;
+
+			const int cIdx = pf->id(cx, cy, cz);
+
+			if (codes[cIdx] != k)
+				continue;
+			if (queued[cIdx].exchange(1) != 0)
+				continue;
+
+			invalid.push_back(cIdx);
+		}
+	}
+
+	for (unsigned int i = 0; i < invalid.size(); i++) {
+		costs[invalid[i]].store(FLOW_INF_COST);
+		codes[invalid[i]] = FLOW_NONE;
+	}
+
+	// re-seed the wavefront from the still-valid border of the
+	// invalidated region (and from the goal if it was included)
+	for (unsigned int i = 0; i < invalid.size(); i++) {
+		const int idx = invalid[i];
+		const Node& n = pf->map[idx];
+
+		queued[idx].store(0);
+
+		if (idx == goalIdx) {
+			costs[idx].store(0.0f);
+			frontier.push_back(idx);
+			continue;
+		}
+
+		for (int k = 0; k < numOffsets; k++) {
+			const int nx = n.x + offsets[k][0];
+			const int ny = n.y + offsets[k][1];
+			const int nz = n.z + offsets[k][2];
+
+			if (nx < 0 || nx >= X || ny < 0 || ny >= Y || nz < 0 || nz >= Z)
+				continue;
+
+			const int nIdx = pf->id(nx, ny, nz);
+
+			if (costs[nIdx].load() >= FLOW_INF_COST)
+				continue;
+			if (queued[nIdx].exchange(1) != 0)
+				continue;
+
+			frontier.push_back(nIdx);
+		}
+	}
+
+	touched = invalid;
+	Propagate(frontier, &touched);
+
+	// a voxel next to one whose cost dropped can gain an equally
+	// cheap alternative, include those so ties are broken exactly
+	// as Generate() would
+	std::vector<int>& cells = frontier;
+	cells.clear();
+
+	for (unsigned int i = 0; i < touched.size(); i++) {
+		const Node& n = pf->map[touched[i]];
+
+		for (int k = -1; k < numOffsets; k++) {
+			const int nx = n.x + ((k < 0)? 0: offsets[k][0]);
+			const int ny = n.y + ((k < 0)? 0: offsets[k][1]);
+			const int nz = n.z + ((k < 0)? 0: offsets[k][2]);
+
+			if (nx < 0 || nx >= X || ny < 0 || ny >= Y || nz < 0 || nz >= Z)
+				continue;
+
+			const int nIdx = pf->id(nx, ny, nz);
+
+			if (queued[nIdx].exchange(1) == 0) {
+				cells.push_back(nIdx);
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < cells.size(); i++) {
+		queued[cells[i]].store(0);
+	}
+
+	ComputeDirections(cells);
+}
+
+
+ubyte CFlowField::GetDirectionCode(int x, int y, int z) const {
+	if (x < 0 || x >= X || y < 0 || y >= Y || z < 0 || z >= Z)
+		return FLOW_NONE;
+
+	return codes[pf->id(x, y, z)];
+}
+
+vec3 CFlowField::GetDirection(const vec3& pos) const {
+	const ubyte code = GetDirectionCode(int(pos.x + 0.5f), int(pos.y + 0.5f), int(pos.z + 0.5f));
+
+	if (code >= numOffsets)
+		return NVec;
+
+	return directions[code];
+}
+
+float CFlowField::GetCost(int x, int y, int z) const {
+	if (x < 0 || x >= X || y < 0 || y >= Y || z < 0 || z >= Z)
+		return FLOW_INF_COST;
+
+	return costs[pf->id(x, y, z)].load();
+}
+
+
+
+void CFlowField::ComputeWeights(int minX, int maxX, int minY, int maxY, int minZ, int maxZ, std::vector<int>& changed) {
+	const int NX = maxX - minX + 1;
+	const int NY = maxY - minY + 1;
+	const int NZ = maxZ - minZ + 1;
+
+	std::vector< std::vector<int> > threadChanged(numThreads);
+
+	// the clearance test at our own radii writes nothing but
+	// <r>, so ranges of nodes can be classified concurrently
+	ParallelFor(NX * NY * NZ, [&](unsigned int t, unsigned int i0, unsigned int i1) {
+		for (unsigned int i = i0; i < i1; i++) {
+			const int x = minX + int(i / (NY * NZ));
+			const int y = minY + int((i / NZ) % NY);
+			const int z = minZ + int(i % NZ);
+			const int idx = pf->id(x, y, z);
+
+			float r = 0.0f;
+
+			// the goal itself is always reachable
+			const bool pass = (pf->PathCanPass(&pf->map[idx], minRad, maxRad, sphereOffsets, &r) || idx == goalIdx);
+			const float w = (pass)? pf->NodeWeight(r, maxRad): -1.0f;
+
+			if (w != weights[idx]) {
+				weights[idx] = w;
+				threadChanged[t].push_back(idx);
+			}
+		}
+	});
+
+	for (unsigned int t = 0; t < threadChanged.size(); t++) {
+		changed.insert(changed.end(), threadChanged[t].begin(), threadChanged[t].end());
+	}
+}
+
+void CFlowField::Propagate(std::vector<int>& frontier, std::vector<int>* touched) {
+	std::vector< std::vector<int> > nexts(numThreads);
+
+	// label-correcting wavefront: every voxel in the frontier
+	// relaxes its neighbours and those whose cost was lowered
+	// form the next frontier, until no cost changes any more
+	// (the fixed point is independent of the processing order)
+	while (!frontier.empty()) {
+		ParallelFor(frontier.size(), [&](unsigned int t, unsigned int i0, unsigned int i1) {
+			nexts[t].clear();
+			PropagateRange(frontier, i0, i1, nexts[t]);
+		});
+
+		frontier.clear();
+
+		for (unsigned int t = 0; t < nexts.size(); t++) {
+			frontier.insert(frontier.end(), nexts[t].begin(), nexts[t].end());
+			nexts[t].clear();
+		}
+
+		if (touched != 0x0) {
+			touched->insert(touched->end(), frontier.begin(), frontier.end());
+		}
+	}
+}
+
+void CFlowField::PropagateRange(const std::vector<int>& frontier, unsigned int i0, unsigned int i1, std::vector<int>& next) {
+	for (unsigned int i = i0; i < i1; i++) {
+		const int idx = frontier[i];
+		const Node& n = pf->map[idx];
+
+		// clear the flag BEFORE reading the cost, so a concurrent
+		// decrease is either seen here or re-queues this voxel
+		queued[idx].store(0);
+
+		const float c = costs[idx].load();
+		const float w = weights[idx];
+
+		// moving from a neighbour onto this voxel costs the
+		// same as A* entering it as a successor
+		for (int k = 0; k < numOffsets; k++) {
+			const int nx = n.x + offsets[k][0];
+			const int ny = n.y + offsets[k][1];
+			const int nz = n.z + offsets[k][2];
+
+			if (nx < 0 || nx >= X || ny < 0 || ny >= Y || nz < 0 || nz >= Z)
+				continue;
+
+			const int nIdx = pf->id(nx, ny, nz);
+
+			if (weights[nIdx] < 0.0f)
+				continue;
+
+			const float nc = c + (w * lengths[k]);
+			float oc = costs[nIdx].load();
+
+			while (nc < oc && !costs[nIdx].compare_exchange_weak(oc, nc)) {
+			}
+
+			if (nc < oc && queued[nIdx].exchange(1) == 0) {
+				next.push_back(nIdx);
+			}
+		}
+	}
+}
+
+void CFlowField::ComputeDirections(const std::vector<int>& cells) {
+	for (unsigned int i = 0; i < cells.size(); i++) {
+		codes[cells[i]] = ComputeDirection(cells[i]);
+	}
+}
+
+void CFlowField::ComputeDirectionsRange(int i0, int i1) {
+	for (int i = i0; i < i1; i++) {
+		codes[i] = ComputeDirection(i);
+	}
+}
+
+ubyte CFlowField::ComputeDirection(int idx) const {
+	if (idx == goalIdx)
+		return FLOW_GOAL;
+	if (weights[idx] < 0.0f || costs[idx].load() >= FLOW_INF_COST)
+		return FLOW_NONE;
+
+	const Node& n = pf->map[idx];
+
+	ubyte bestCode = FLOW_NONE;
+	float bestCost = FLOW_INF_COST;
+
+	// pick the neighbour through which our cost was
+	// realized (first one in offset order on ties)
+	for (int k = 0; k < numOffsets; k++) {
+		const int nx = n.x + offsets[k][0];
+		const int ny = n.y + offsets[k][1];
+		const int nz = n.z + offsets[k][2];
+
+		if (nx < 0 || nx >= X || ny < 0 || ny >= Y || nz < 0 || nz >= Z)
+			continue;
+
+		const int nIdx = pf->id(nx, ny, nz);
+
+		if (weights[nIdx] < 0.0f)
+			continue;
+
+		const float c = costs[nIdx].load() + (weights[nIdx] * lengths[k]);
+
+		if (c < bestCost) {
+			bestCost = c;
+			bestCode = k;
+		}
+	}
+
+	return bestCode;
+}
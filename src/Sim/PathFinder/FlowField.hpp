@@ -0,0 +1,87 @@
+#ifndef FLOWFIELD_HPP
+#define FLOWFIELD_HPP
+
+#include <vector>
+#include <atomic>
+
+#include "../../Common/CommonTypes.hpp"
+#include "../../Math/vec3.hpp"
+#include "./SphereBlockOffset.hpp"
+
+// direction codes 0 to 25 index CFlowField::offsets
+#define FLOW_GOAL 254
+#define FLOW_NONE 255
+
+class CPathFinder;
+class CThreadPool;
+
+// goal-rooted flow field: a (parallel, label-correcting)
+// Dijkstra run backwards from the goal over the clearance
+// constrained grid, after which every voxel stores the 8-bit
+// code of the neighbour an agent standing there should move
+// to next, so any number of agents can steer in O(1)
+//
+// the per-voxel costs are kept around so the field can be
+// repaired locally when the map changes (the pathfinder
+// calls UpdateBlock from toggleBlocked)
+class CFlowField {
+	public:
+		CFlowField(CPathFinder* pf);
+		~CFlowField();
+
+		// threads the work runs on (0x0: the calling thread)
+		void SetThreadPool(CThreadPool* p) { pool = p; }
+		// the work is split into <numThreads> chunks (0: one per
+		// thread of the pool)
+		void Generate(int gx, int gy, int gz, float minRad, float maxRad, unsigned int numThreads = 0);
+		// (un)blocking voxel <x, y, z> changed the map
+		void UpdateBlock(int x, int y, int z);
+
+		// the whole map changed (eg. CPathFinder::Reset)
+		void Invalidate() { goalIdx = -1; codes.assign(codes.size(), FLOW_NONE); }
+		bool IsValid() const { return (goalIdx >= 0); }
+		ubyte GetDirectionCode(int x, int y, int z) const;
+		// unit vector towards the next voxel (NVec at the goal or
+		// if the goal cannot be reached from <pos>)
+		vec3 GetDirection(const vec3& pos) const;
+		float GetCost(int x, int y, int z) const;
+
+	private:
+		void ComputeWeights(int minX, int maxX, int minY, int maxY, int minZ, int maxZ, std::vector<int>& changed);
+		void Propagate(std::vector<int>& frontier, std::vector<int>* touched);
+		void PropagateRange(const std::vector<int>& frontier, unsigned int i0, unsigned int i1, std::vector<int>& next);
+		void ComputeDirections(const std::vector<int>& cells);
+		void ComputeDirectionsRange(int i0, int i1);
+		ubyte ComputeDirection(int idx) const;
+
+		template<typename F> void ParallelFor(unsigned int n, F f) const;
+
+		CPathFinder* pf;
+		CThreadPool* pool;
+
+		int X, Y, Z;
+		int goalIdx;
+		unsigned int numThreads;
+		float minRad, maxRad;
+
+		// the clearance test's offsets for maxRad (the
+		// pathfinder's own radii are left alone)
+		std::vector<SphereBlockOffset> sphereOffsets;
+
+		// neighbourhood (depends on the pathfinder's connectivity)
+		int numOffsets;
+		int offsets[26][3];
+		float lengths[26];
+		vec3 directions[26];
+
+		// per-voxel step weight (< 0 if the corridor cannot pass)
+		std::vector<float> weights;
+		std::vector<ubyte> codes;
+
+		// accumulated cost-to-goal, lowered concurrently
+		std::atomic<float>* costs;
+		// whether a voxel is already in the next frontier
+		std::atomic<ubyte>* queued;
+};
+
+#endif
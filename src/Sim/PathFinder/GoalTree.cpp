@@ -0,0 +1,187 @@
+#include <algorithm>
+
+#include "./GoalTree.hpp"
+#include "./PathFinder.hpp"
+
+CGoalTree::CGoalTree(CPathFinder* pf, unsigned int maxBytes) {
+	this->pf = pf;
+	this->maxBytes = maxBytes;
+
+	valid = false;
+	overCap = false;
+	sId = -1;
+
+	numQueries = 0;
+	numSettledHits = 0;
+	numExpanded = 0;
+	numBuilds = 0;
+}
+
+void CGoalTree::Clear() {
+	nodes.clear();
+	open.clear();
+	valid = false;
+}
+
+unsigned int CGoalTree::GetMemoryUsage() const {
+	// every entry is a separate heap node with a next-pointer
+	const unsigned int entrySize = sizeof(std::pair<const int, TreeNode>) + 2 * sizeof(void*);
+
+	return
+		nodes.size() * entrySize +
+		nodes.bucket_count() * sizeof(void*) +
+		open.capacity() * sizeof(OpenEntry);
+}
+
+
+
+void CGoalTree::BeginQuery(const GoalTreeKey& key, int sId) {
+	numQueries++;
+	overCap = false;
+
+	if (!valid || !(key == this->key) || GetMemoryUsage() > maxBytes) {
+		this->key = key;
+		this->sId = sId;
+		Root();
+	} else if (sId != this->sId) {
+		this->sId = sId;
+		Rekey();
+	}
+
+	const std::unordered_map<int, TreeNode>::const_iterator it = nodes.find(sId);
+
+	if (it != nodes.end() && it->second.closed) {
+		numSettledHits++;
+	}
+}
+
+searchState CGoalTree::Step() {
+	const std::unordered_map<int, TreeNode>::const_iterator it = nodes.find(sId);
+
+	if (it != nodes.end() && it->second.closed)
+		return SEARCH_FOUND;
+
+	if (!overCap && GetMemoryUsage() > maxBytes) {
+		// start over, but let this query finish past the cap
+		overCap = true;
+		Root();
+	}
+
+	if (open.empty())
+		return SEARCH_FAILED;
+
+	std::pop_heap(open.begin(), open.end());
+	const OpenEntry e = open.back(); open.pop_back();
+
+	TreeNode& v = nodes[e.node];
+
+	if (v.closed || e.g > v.g)
+		return SEARCH_RUNNING;
+
+	v.closed = true;
+
+	// a settled start is expanded like any other node (FOUND
+	// is returned by the check above on the next step), or
+	// later queries could not route through it
+	if (!v.passable)
+		return SEARCH_RUNNING;
+
+	numExpanded++;
+
+	const Node* vn = &pf->map[e.node];
+	const float vg = v.g;
+	const float vw = v.w;
+
+	Node* nbrs[26];
+	const int numNbrs = pf->GetNeighbours(vn, nbrs);
+
+	for (int i = 0; i < numNbrs; i++) {
+		Node* un = nbrs[i];
+
+		// the forward search pays the weight of the node it
+		// steps onto, so moving from <un> onto <vn> costs this
+		const float c = vg + vw * pf->Distance(un, vn);
+		const std::unordered_map<int, TreeNode>::iterator uit = nodes.find(un->id);
+
+		if (uit == nodes.end()) {
+			TreeNode u;
+			u.passable = pf->PathCanPass(un);
+			u.w = pf->NodeWeight(un);
+			u.g = c;
+			u.parent = e.node;
+			u.closed = false;
+
+			nodes[un->id] = u;
+		} else {
+			TreeNode& u = uit->second;
+
+			if (u.closed || c >= u.g)
+				continue;
+
+			u.g = c;
+			u.parent = e.node;
+		}
+
+		const OpenEntry ue = {int(un->id), c, c + StartDistance(un->id)};
+		open.push_back(ue);
+		std::push_heap(open.begin(), open.end());
+
+#if (SEARCH_TRACE == 1)
+		if (pf->trace.IsOn())
+			pf->trace.RecordOpen(un->id, e.node);
+#endif
+	}
+
+	return SEARCH_RUNNING;
+}
+
+void CGoalTree::TracePath(std::vector<ANode*>& path) const {
+	const unsigned int n = path.size();
+	int i = nodes.find(sId)->second.parent;
+
+	while (i != -1) {
+		path.push_back(&pf->map[i]);
+		i = nodes.find(i)->second.parent;
+	}
+
+	// the parent chain runs from the start to the goal
+	std::reverse(path.begin() + n, path.end());
+}
+
+
+
+void CGoalTree::Root() {
+	Node* g = &pf->map[key.gId];
+
+	nodes.clear();
+	open.clear();
+
+	TreeNode t;
+	t.passable = pf->PathCanPass(g);
+	t.w = pf->NodeWeight(g);
+	t.g = 0.0f;
+	t.parent = -1;
+	t.closed = false;
+
+	nodes[key.gId] = t;
+
+	const OpenEntry e = {key.gId, 0.0f, StartDistance(key.gId)};
+	open.push_back(e);
+
+	valid = true;
+	numBuilds++;
+}
+
+void CGoalTree::Rekey() {
+	for (unsigned int i = 0; i < open.size(); i++) {
+		open[i].f = open[i].g + StartDistance(open[i].node);
+	}
+
+	std::make_heap(open.begin(), open.end());
+}
+
+float CGoalTree::StartDistance(int node) const {
+	// no step costs less than MinNodeWeight() per unit, so
+	// this stays consistent for any start
+	return (pf->MinNodeWeight() * pf->Distance(&pf->map[node], &pf->map[sId]));
+}
@@ -0,0 +1,119 @@
+#ifndef GOALTREE_HPP
+#define GOALTREE_HPP
+
+#include <vector>
+#include <unordered_map>
+
+#include "./AAStar.hpp"
+
+// default cap (in bytes) on the memory a goal tree may use
+#define GOALTREEMAXBYTES (16 * 1024 * 1024)
+
+class ANode;
+class Node;
+class CPathFinder;
+
+// everything a goal tree's costs depend on; a tree built for
+// one key is useless for any other
+struct GoalTreeKey {
+	bool operator == (const GoalTreeKey& k) const {
+		return
+			(gId == k.gId && minRad == k.minRad && maxRad == k.maxRad) &&
+			(mapVersion == k.mapVersion && snapshotVersion == k.snapshotVersion);
+	}
+
+	int gId;
+	float minRad;
+	float maxRad;
+	// CPathFinder::mapVersion (connectivity, heuristic, Reset)
+	unsigned int mapVersion;
+	// CMapSnapshot::GetVersion (every toggleBlocked)
+	unsigned int snapshotVersion;
+};
+
+// backward A* tree rooted at a goal that is kept between
+// queries with that goal: a start the tree already settled
+// is answered without expanding anything, any other start
+// resumes the search from the tree's frontier (re-keyed
+// for the new start) until it is settled as well
+//
+// every settled node holds its exact cost-to-goal, so the
+// paths are optimal (unlike the forward search with its
+// weighted heuristic they can differ from search()'s);
+// the tree is rebuilt whenever its key changes and dropped
+// once it holds more than <maxBytes>
+class CGoalTree {
+	public:
+		CGoalTree(CPathFinder* pf, unsigned int maxBytes = GOALTREEMAXBYTES);
+
+		// starts a query from <sId>; the snapshot the key's
+		// version comes from must stay pinned until it is done
+		void BeginQuery(const GoalTreeKey& key, int sId);
+		// settles one more node; FOUND once the start is settled
+		// (right away if it already was), FAILED if the goal
+		// cannot be reached from it
+		searchState Step();
+		// fills <path> like AAStar::findPath (from the goal up
+		// to, but not including, the start); only valid after
+		// Step returned FOUND
+		void TracePath(std::vector<ANode*>& path) const;
+
+		void Clear();
+
+		unsigned int GetNumQueries() const { return numQueries; }
+		// queries answered without a single expansion
+		unsigned int GetNumSettledHits() const { return numSettledHits; }
+		unsigned int GetNumExpanded() const { return numExpanded; }
+		// trees built from scratch (key changes and cap hits)
+		unsigned int GetNumBuilds() const { return numBuilds; }
+		unsigned int GetNumNodes() const { return nodes.size(); }
+		unsigned int GetMemoryUsage() const;
+
+	private:
+		struct TreeNode {
+			float g;
+			float w;
+			int parent;
+			bool closed;
+			// whether the clearance lets a path pass through it
+			// (one that does not can still be a start)
+			bool passable;
+		};
+
+		struct OpenEntry {
+			int node;
+			float g;
+			float f;
+
+			// min-heap on f, larger g first among equal f
+			bool operator < (const OpenEntry& e) const {
+				if (f != e.f) return (f > e.f);
+				return (g < e.g);
+			}
+		};
+
+		void Root();
+		void Rekey();
+		float StartDistance(int node) const;
+
+		CPathFinder* pf;
+		unsigned int maxBytes;
+
+		GoalTreeKey key;
+		bool valid;
+		// set when the cap forced a rebuild during the current
+		// query (which may then exceed it, rather than loop)
+		bool overCap;
+
+		int sId;
+
+		std::unordered_map<int, TreeNode> nodes;
+		std::vector<OpenEntry> open;
+
+		unsigned int numQueries;
+		unsigned int numSettledHits;
+		unsigned int numExpanded;
+		unsigned int numBuilds;
+};
+
+#endif
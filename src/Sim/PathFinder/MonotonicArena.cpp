@@ -0,0 +1,76 @@
+#include <new>
+#include <cstdint>
+#include <algorithm>
+
+#include "./MonotonicArena.hpp"
+
+CMonotonicArena::CMonotonicArena(std::size_t initialSize) {
+	curBlock = 0;
+	offset = 0;
+	usage = 0;
+	numBlockAllocs = 0;
+
+	AddBlock(initialSize);
+}
+
+CMonotonicArena::~CMonotonicArena() {
+	for (unsigned int i = 0; i < blocks.size(); i++) {
+		::operator delete(blocks[i].mem);
+	}
+}
+
+std::size_t CMonotonicArena::GetCapacity() const {
+	std::size_t size = 0;
+
+	for (unsigned int i = 0; i < blocks.size(); i++) {
+		size += blocks[i].size;
+	}
+
+	return size;
+}
+
+void CMonotonicArena::Reset() {
+	if (blocks.size() > 1) {
+		const std::size_t size = GetCapacity();
+
+		for (unsigned int i = 0; i < blocks.size(); i++) {
+			::operator delete(blocks[i].mem);
+		}
+
+		blocks.clear();
+		AddBlock(size);
+	}
+
+	curBlock = 0;
+	offset = 0;
+	usage = 0;
+}
+
+void* CMonotonicArena::do_allocate(std::size_t bytes, std::size_t alignment) {
+	while (true) {
+		const Block& b = blocks[curBlock];
+		const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(b.mem);
+		const std::size_t start = ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+
+		if ((start + bytes) <= b.size) {
+			offset = start + bytes;
+			usage += bytes;
+			return (b.mem + start);
+		}
+
+		// the current block is always the last one
+		AddBlock(std::max(b.size * 2, bytes + alignment));
+
+		curBlock += 1;
+		offset = 0;
+	}
+}
+
+void CMonotonicArena::AddBlock(std::size_t size) {
+	Block b;
+	b.mem = static_cast<char*>(::operator new(size));
+	b.size = size;
+
+	blocks.push_back(b);
+	numBlockAllocs += 1;
+}
@@ -0,0 +1,49 @@
+#ifndef MONOTONICARENA_HPP
+#define MONOTONICARENA_HPP
+
+#include <vector>
+#include <memory_resource>
+
+// memory resource for containers that only live as long as
+// one unit of work (a search, a query): allocations bump a
+// pointer, deallocations do nothing and Reset() forgets the
+// lot at once (after the containers let go of it)
+//
+// blocks are kept across resets, and any that had to be
+// added since the last one are merged into a single block
+// big enough for all of them, so once the work stops
+// growing the arena never touches the heap again
+class CMonotonicArena: public std::pmr::memory_resource {
+	public:
+		CMonotonicArena(std::size_t initialSize);
+		~CMonotonicArena();
+
+		void Reset();
+
+		// blocks taken from the heap since construction
+		unsigned int GetNumBlockAllocs() const { return numBlockAllocs; }
+		std::size_t GetCapacity() const;
+		// bytes handed out since the last Reset
+		std::size_t GetUsage() const { return usage; }
+
+	private:
+		struct Block {
+			char* mem;
+			std::size_t size;
+		};
+
+		void* do_allocate(std::size_t bytes, std::size_t alignment);
+		void do_deallocate(void*, std::size_t, std::size_t) {}
+		bool do_is_equal(const std::pmr::memory_resource& r) const noexcept { return (this == &r); }
+
+		void AddBlock(std::size_t size);
+
+		std::vector<Block> blocks;
+		unsigned int curBlock;
+		std::size_t offset;
+		std::size_t usage;
+
+		unsigned int numBlockAllocs;
+};
+
+#endif
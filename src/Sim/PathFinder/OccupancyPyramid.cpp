@@ -0,0 +1,201 @@
+#include <cmath>
+#include <algorithm>
+
+#include "./OccupancyPyramid.hpp"
+#include "./PathFinder.hpp"
+
+#define NODE(n) static_cast<Node*>(n)
+
+COccupancyPyramid::COccupancyPyramid(CPathFinder* pf) {
+	const vec3 size = pf->GetWorldSize();
+
+	this->pf = pf;
+	this->X = int(size.x);
+	this->Y = int(size.y);
+	this->Z = int(size.z);
+
+	minRad = maxRad = 0.0f;
+}
+
+void COccupancyPyramid::Build(float minRad, float maxRad) {
+	this->minRad = minRad;
+	this->maxRad = maxRad;
+
+	levels.clear();
+	pf->GenerateSphereBlockOffsets(maxRad, sphereOffsets);
+
+	// halve the resolution until a single cell remains
+	for (int l = 0; ; l++) {
+		levels.push_back(std::vector<ubyte>(GetSizeX(l) * GetSizeY(l) * GetSizeZ(l), 0));
+
+		if (GetSizeX(l) == 1 && GetSizeY(l) == 1 && GetSizeZ(l) == 1)
+			break;
+	}
+
+	UpdateLevel0(0, X - 1, 0, Y - 1, 0, Z - 1);
+
+	for (unsigned int l = 1; l < levels.size(); l++) {
+		UpdateLevel(l, 0, GetSizeX(l) - 1, 0, GetSizeY(l) - 1, 0, GetSizeZ(l) - 1);
+	}
+}
+
+void COccupancyPyramid::UpdateBlock(int x, int y, int z) {
+	if (levels.empty()) {
+		return;
+	}
+
+	// every node whose sphere of radius maxRad can
+	// contain (x, y, z) may have changed clearance
+	const int R = int(ceilf(maxRad)) + 1;
+
+	int minX = std::max(0, x - R), maxX = std::min(X - 1, x + R);
+	int minY = std::max(0, y - R), maxY = std::min(Y - 1, y + R);
+	int minZ = std::max(0, z - R), maxZ = std::min(Z - 1, z + R);
+
+	UpdateLevel0(minX, maxX, minY, maxY, minZ, maxZ);
+
+	for (unsigned int l = 1; l < levels.size(); l++) {
+		minX >>= 1; maxX >>= 1;
+		minY >>= 1; maxY >>= 1;
+		minZ >>= 1; maxZ >>= 1;
+
+		UpdateLevel(l, minX, maxX, minY, maxY, minZ, maxZ);
+	}
+}
+
+bool COccupancyPyramid::IsBuilt(float minRad, float maxRad) const {
+	return (!levels.empty() && this->minRad == minRad && this->maxRad == maxRad);
+}
+
+bool COccupancyPyramid::IsPassable(int level, int x, int y, int z, float minRad) const {
+	return ((levels[level][GetIndex(level, x, y, z)] * RADIALSTEP) >= (minRad - EPSILON));
+}
+
+int COccupancyPyramid::GetCoarseLevel() const {
+	for (unsigned int l = 1; l < levels.size(); l++) {
+		if ((GetSizeX(l) * GetSizeY(l) * GetSizeZ(l)) <= PYRAMID_MAX_COARSE_CELLS) {
+			return l;
+		}
+	}
+
+	return 0;
+}
+
+void COccupancyPyramid::UpdateLevel0(int minX, int maxX, int minY, int maxY, int minZ, int maxZ) {
+	std::vector<ubyte>& level0 = levels[0];
+
+	for (int x = minX; x <= maxX; x++) {
+		for (int y = minY; y <= maxY; y++) {
+			for (int z = minZ; z <= maxZ; z++) {
+				float r = 0.0f;
+
+				// sets r regardless of the outcome
+				pf->PathCanPass(&pf->map[pf->id(x, y, z)], minRad, maxRad, sphereOffsets, &r);
+
+				level0[GetIndex(0, x, y, z)] = ubyte(std::max(0.0f, r) / RADIALSTEP + 0.5f);
+			}
+		}
+	}
+}
+
+void COccupancyPyramid::UpdateLevel(int level, int minX, int maxX, int minY, int maxY, int minZ, int maxZ) {
+	const std::vector<ubyte>& src = levels[level - 1];
+	std::vector<ubyte>& dst = levels[level];
+
+	const int srcX = GetSizeX(level - 1);
+	const int srcY = GetSizeY(level - 1);
+	const int srcZ = GetSizeZ(level - 1);
+
+	for (int x = minX; x <= maxX; x++) {
+		for (int y = minY; y <= maxY; y++) {
+			for (int z = minZ; z <= maxZ; z++) {
+				ubyte c = 255;
+
+				for (int i = (x << 1); i <= std::min((x << 1) + 1, srcX - 1); i++) {
+					for (int j = (y << 1); j <= std::min((y << 1) + 1, srcY - 1); j++) {
+						for (int k = (z << 1); k <= std::min((z << 1) + 1, srcZ - 1); k++) {
+							c = std::min(c, src[GetIndex(level - 1, i, j, k)]);
+						}
+					}
+				}
+
+				dst[GetIndex(level, x, y, z)] = c;
+			}
+		}
+	}
+}
+
+
+
+bool CPyramidSearch::search(int level, const Node* s, const Node* g, float minRad, std::vector<ANode*>& coarsePath) {
+	if (level != this->level) {
+		this->level = level;
+
+		sizeX = pyramid->GetSizeX(level);
+		sizeY = pyramid->GetSizeY(level);
+		sizeZ = pyramid->GetSizeZ(level);
+
+		nodes.clear();
+		nodes.reserve(sizeX * sizeY * sizeZ);
+
+		for (int x = 0; x < sizeX; x++) {
+			for (int y = 0; y < sizeY; y++) {
+				for (int z = 0; z < sizeZ; z++) {
+					nodes.push_back(Node(x, y, z, nodes.size(), 1.0f));
+				}
+			}
+		}
+	}
+
+	this->minRad = minRad;
+
+	startCell = &nodes[((s->x >> level) * sizeY * sizeZ) + ((s->y >> level) * sizeZ) + (s->z >> level)];
+	goalCell  = &nodes[((g->x >> level) * sizeY * sizeZ) + ((g->y >> level) * sizeZ) + (g->z >> level)];
+	start = startCell;
+	goal = goalCell;
+
+	coarsePath.clear();
+
+	if (startCell == goalCell) {
+		return true;
+	}
+
+	return findPath(coarsePath);
+}
+
+void CPyramidSearch::successors(ANode* an, NodeList& succ) {
+	const Node* n = NODE(an);
+
+	for (int i = -1; i <= 1; i++) {
+		for (int j = -1; j <= 1; j++) {
+			for (int k = -1; k <= 1; k++) {
+				if (k == 0 && j == 0 && i == 0)
+					continue;
+
+				const int x = n->x + i;
+				const int y = n->y + j;
+				const int z = n->z + k;
+
+				if (x < 0 || x >= sizeX || y < 0 || y >= sizeY || z < 0 || z >= sizeZ)
+					continue;
+
+				Node* s = &nodes[(x * sizeY * sizeZ) + (y * sizeZ) + z];
+
+				// the start- and goal-cells themselves may contain
+				// obstacles (only the nodes themselves must be free)
+				if (s == goalCell || pyramid->IsPassable(level, x, y, z, minRad)) {
+					succ.push_back(s);
+				}
+			}
+		}
+	}
+}
+
+float CPyramidSearch::heuristic(ANode* an1, ANode* an2) {
+	const Node* n1 = NODE(an1);
+	const Node* n2 = NODE(an2);
+	const int dx = n1->x - n2->x;
+	const int dy = n1->y - n2->y;
+	const int dz = n1->z - n2->z;
+	return sqrtf(dx*dx + dy*dy + dz*dz);
+}
@@ -0,0 +1,84 @@
+#ifndef OCCUPANCYPYRAMID_HPP
+#define OCCUPANCYPYRAMID_HPP
+
+#include <vector>
+
+#include "./AAStar.hpp"
+#include "./Node.hpp"
+#include "./SphereBlockOffset.hpp"
+#include "../../Common/CommonTypes.hpp"
+
+// the coarse search runs on the finest level with at
+// most this many cells (but never on level 0 itself)
+#define PYRAMID_MAX_COARSE_CELLS (64 * 64 * 64)
+
+class CPathFinder;
+
+// mip-mapped clearance over CPathFinder::map: level 0 holds
+// the corridor radius PathCanPass finds at every node (in
+// RADIALSTEP units) and every cell of level l + 1 holds the
+// MINIMUM over its (up to) 2x2x2 children on level l, so a
+// coarse cell is passable only if all nodes inside it are
+class COccupancyPyramid {
+	public:
+		COccupancyPyramid(CPathFinder* pf);
+
+		void Build(float minRad, float maxRad);
+		// call after pf->toggleBlocked(x, y, z)
+		void UpdateBlock(int x, int y, int z);
+		void Invalidate() { levels.clear(); }
+
+		bool IsBuilt(float minRad, float maxRad) const;
+		bool IsPassable(int level, int x, int y, int z, float minRad) const;
+		int GetNumLevels() const { return levels.size(); }
+		int GetCoarseLevel() const;
+		int GetSizeX(int level) const { return ((X - 1) >> level) + 1; }
+		int GetSizeY(int level) const { return ((Y - 1) >> level) + 1; }
+		int GetSizeZ(int level) const { return ((Z - 1) >> level) + 1; }
+
+	private:
+		void UpdateLevel0(int minX, int maxX, int minY, int maxY, int minZ, int maxZ);
+		void UpdateLevel(int level, int minX, int maxX, int minY, int maxY, int minZ, int maxZ);
+		int GetIndex(int level, int x, int y, int z) const {
+			return ((x * GetSizeY(level) * GetSizeZ(level)) + (y * GetSizeZ(level)) + z);
+		}
+
+		CPathFinder* pf;
+
+		int X, Y, Z;
+		float minRad, maxRad;
+
+		// the clearance test's offsets for maxRad (kept apart
+		// from the pathfinder's own, which stay untouched)
+		std::vector<SphereBlockOffset> sphereOffsets;
+
+		std::vector< std::vector<ubyte> > levels;
+};
+
+
+// A* over a single coarse level of the pyramid
+class CPyramidSearch: public AAStar {
+	public:
+		CPyramidSearch(const COccupancyPyramid* p): pyramid(p), level(-1) {}
+
+		// node coordinates are in full-resolution space, the
+		// returned path runs from the goal cell to (but not
+		// including) the start cell
+		bool search(int level, const Node* s, const Node* g, float minRad, std::vector<ANode*>& coarsePath);
+
+	private:
+		void successors(ANode* an, NodeList& succ);
+		float heuristic(ANode* an1, ANode* an2);
+
+		const COccupancyPyramid* pyramid;
+
+		int level;
+		int sizeX, sizeY, sizeZ;
+		float minRad;
+
+		std::vector<Node> nodes;
+		Node* startCell;
+		Node* goalCell;
+};
+
+#endif
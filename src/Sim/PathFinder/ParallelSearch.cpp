@@ -0,0 +1,356 @@
+#include <thread>
+#include <cstdio>
+#include <SDL/SDL_timer.h>
+
+#include "./ParallelSearch.hpp"
+#include "./PathFinder.hpp"
+
+#define NODE(n) static_cast<Node*>(n)
+
+// per-node clearance state (computed once by the node's owner)
+#define HDA_STATE_UNKNOWN 0
+#define HDA_STATE_PASSABLE 1
+#define HDA_STATE_BLOCKED 2
+
+static const float HDA_INF_COST = 1e30f;
+
+bool CParallelSearch::MessageQueue::Push(const Message& m) {
+	const unsigned int t = tail.load(std::memory_order_relaxed);
+
+	if ((t - head.load(std::memory_order_acquire)) == HDA_QUEUE_SIZE)
+		return false;
+
+	ring[t & (HDA_QUEUE_SIZE - 1)] = m;
+	tail.store(t + 1, std::memory_order_release);
+	return true;
+}
+
+bool CParallelSearch::MessageQueue::Pop(Message& m) {
+	const unsigned int h = head.load(std::memory_order_relaxed);
+
+	if (h == tail.load(std::memory_order_acquire))
+		return false;
+
+	m = ring[h & (HDA_QUEUE_SIZE - 1)];
+	head.store(h + 1, std::memory_order_release);
+	return true;
+}
+
+
+
+CParallelSearch::CParallelSearch(CPathFinder* pf): pool(1) {
+	this->pf = pf;
+
+	numThreads = 0;
+	queues = 0x0;
+	goalNode = -1;
+
+	pathCost = 0.0f;
+	numExpanded = 0;
+	numMessages = 0;
+}
+
+CParallelSearch::~CParallelSearch() {
+	delete[] queues; queues = 0x0;
+}
+
+bool CParallelSearch::search(float minRad, float maxRad, unsigned int numThreads, std::vector<ANode*>& path) {
+	const int N = pf->map.size();
+
+	numThreads = std::max(numThreads, 1U);
+
+	if (numThreads != this->numThreads) {
+		this->numThreads = numThreads;
+
+		// a finished search leaves every queue empty, so they
+		// only need replacing when their number changes
+		delete[] queues;
+		queues = new MessageQueue[numThreads * numThreads];
+
+		threads.clear();
+		threads.resize(numThreads);
+		pool.SetNumThreads(numThreads);
+
+		for (unsigned int t = 0; t < numThreads; t++) {
+			threads[t].outbox.resize(numThreads);
+		}
+	}
+
+	pf->SetSearchRadii(minRad, maxRad);
+
+	gs.assign(N, HDA_INF_COST);
+	hs.assign(N, 0.0f);
+	weights.assign(N, 0.0f);
+	parents.assign(N, -1);
+	states.assign(N, HDA_STATE_UNKNOWN);
+
+	for (unsigned int t = 0; t < numThreads; t++) {
+		// entries the last search did not need to expand
+		threads[t].open = std::priority_queue<OpenEntry>();
+		threads[t].numExpanded = 0;
+		threads[t].numMessages = 0;
+		threads[t].busy = false;
+	}
+
+	// the threads read the map through PathCanPass, which is
+	// only safe on a pinned snapshot off the editing thread
+	CPathFinder::SnapshotPin pin(pf);
+
+	incumbent.store(HDA_INF_COST);
+	goalNode = -1;
+
+	// seed the owner of the start node, which holds
+	// the only unit of work until it sends something
+	{
+		Node* s = NODE(pf->start);
+		SearchThread& st = threads[Owner(s->id)];
+
+		pf->PathCanPass(s);
+		weights[s->id] = pf->NodeWeight(s);
+		hs[s->id] = weights[s->id] * GoalDistance(s);
+		gs[s->id] = 0.0f;
+		states[s->id] = HDA_STATE_PASSABLE;
+
+		OpenEntry e = {int(s->id), hs[s->id], 0.0f};
+		st.open.push(e);
+		st.busy = true;
+		work.store(1);
+	}
+
+	pool.Run(numThreads, [this](unsigned int t) { Run(t); });
+
+	numExpanded = 0;
+	numMessages = 0;
+
+	for (unsigned int t = 0; t < numThreads; t++) {
+		numExpanded += threads[t].numExpanded;
+		numMessages += threads[t].numMessages;
+	}
+
+	if (goalNode < 0) {
+		pathCost = 0.0f;
+		return false;
+	}
+
+	// all threads are done, so the parent links are stable
+	for (int n = goalNode; n != int(pf->start->id); n = parents[n]) {
+		path.push_back(&pf->map[n]);
+	}
+
+	pathCost = incumbent.load();
+	return true;
+}
+
+void CParallelSearch::Run(unsigned int t) {
+	SearchThread& st = threads[t];
+	Message m;
+
+	while (true) {
+		int numReceived = 0;
+
+		for (unsigned int s = 0; s < numThreads; s++) {
+			if (s == t)
+				continue;
+
+			MessageQueue& q = GetQueue(s, t);
+
+			while (q.Pop(m)) {
+				// take a unit of work before the sender's one
+				// is released, so the count never touches zero
+				if (!st.busy) {
+					st.busy = true;
+					work.fetch_add(1);
+				}
+
+				Receive(st, m);
+				numReceived++;
+			}
+		}
+
+		if (numReceived > 0) {
+			work.fetch_sub(numReceived);
+		}
+
+		// back off while a receiver is behind: expanding further
+		// would only bury it in messages generated from g-values
+		// it may already have improved on
+		const bool blocked = FlushOutbox(t);
+
+		for (unsigned int n = 0; !blocked && n < HDA_EXPANSION_BATCH && !st.open.empty(); ) {
+			const OpenEntry e = st.open.top();
+
+			// nothing left here can improve on the incumbent
+			if (e.f >= incumbent.load(std::memory_order_relaxed))
+				break;
+
+			st.open.pop();
+
+			if (e.g > gs[e.node])
+				continue;
+
+			Expand(t, e);
+			n++;
+		}
+
+		if (!st.open.empty() && st.open.top().f < incumbent.load(std::memory_order_relaxed)) {
+			if (blocked)
+				std::this_thread::yield();
+
+			continue;
+		}
+
+		// messages still in the outbox keep their own units
+		// of work, so going idle here cannot end the search
+		if (st.busy) {
+			st.busy = false;
+			work.fetch_sub(1);
+		}
+
+		if (work.load() == 0)
+			break;
+
+		std::this_thread::yield();
+	}
+}
+
+void CParallelSearch::Receive(SearchThread& st, const Message& m) {
+	Node* n = &pf->map[m.node];
+
+	if (states[m.node] == HDA_STATE_UNKNOWN) {
+		if (pf->PathCanPass(n)) {
+			weights[m.node] = pf->NodeWeight(n);
+			hs[m.node] = weights[m.node] * GoalDistance(n);
+			states[m.node] = HDA_STATE_PASSABLE;
+		} else {
+			states[m.node] = HDA_STATE_BLOCKED;
+		}
+	}
+
+	if (states[m.node] == HDA_STATE_BLOCKED)
+		return;
+
+	const float g = m.parentG + weights[m.node] * pf->Distance(&pf->map[m.parent], n);
+	const float f = g + hs[m.node];
+
+	if (g >= gs[m.node])
+		return;
+	if (f >= incumbent.load(std::memory_order_relaxed))
+		return;
+
+	gs[m.node] = g;
+	parents[m.node] = m.parent;
+
+	OpenEntry e = {m.node, f, g};
+	st.open.push(e);
+}
+
+void CParallelSearch::Expand(unsigned int t, const OpenEntry& e) {
+	Node* n = &pf->map[e.node];
+
+	if (n->bType == GOAL) {
+		OnGoalReached(e.node, e.g);
+		return;
+	}
+
+	threads[t].numExpanded++;
+
+	Node* nbrs[26];
+	const int numNbrs = pf->GetNeighbours(n, nbrs);
+	int numRemote = 0;
+
+	for (int i = 0; i < numNbrs; i++) {
+		numRemote += (Owner(nbrs[i]->id) != t);
+	}
+
+	// account for every outgoing message before the first
+	// one becomes visible to its receiver
+	if (numRemote > 0) {
+		work.fetch_add(numRemote);
+	}
+
+	for (int i = 0; i < numNbrs; i++) {
+		const unsigned int o = Owner(nbrs[i]->id);
+		const Message m = {int(nbrs[i]->id), e.node, e.g};
+
+		if (o == t) {
+			Receive(threads[t], m);
+		} else {
+			Send(t, o, m);
+		}
+	}
+}
+
+void CParallelSearch::Send(unsigned int t, unsigned int o, const Message& m) {
+	std::vector<Message>& ob = threads[t].outbox[o];
+
+	threads[t].numMessages++;
+
+	// keep the per-pair order (not needed, but cheap)
+	if (!ob.empty() || !GetQueue(t, o).Push(m)) {
+		ob.push_back(m);
+	}
+}
+
+bool CParallelSearch::FlushOutbox(unsigned int t) {
+	bool pending = false;
+
+	for (unsigned int o = 0; o < numThreads; o++) {
+		std::vector<Message>& ob = threads[t].outbox[o];
+		MessageQueue& q = GetQueue(t, o);
+		unsigned int i = 0;
+
+		while (i < ob.size() && q.Push(ob[i])) {
+			i++;
+		}
+
+		ob.erase(ob.begin(), ob.begin() + i);
+		pending |= !ob.empty();
+	}
+
+	return pending;
+}
+
+void CParallelSearch::OnGoalReached(int node, float g) {
+	std::lock_guard<std::mutex> lock(goalMutex);
+
+	if (g < incumbent.load()) {
+		incumbent.store(g);
+		goalNode = node;
+	}
+}
+
+float CParallelSearch::GoalDistance(const Node* n) const {
+	float minDist = HDA_INF_COST;
+
+	for (unsigned int i = 0; i < pf->goals.size(); i++) {
+		minDist = std::min(minDist, pf->Distance(n, pf->goals[i]));
+	}
+
+	return minDist;
+}
+
+
+
+void CParallelSearch::Benchmark(float minRad, float maxRad, unsigned int maxThreads) {
+	std::vector<ANode*> path;
+	unsigned int baseTime = 1;
+
+	printf("[CParallelSearch::Benchmark] %u hardware threads\n", std::thread::hardware_concurrency());
+
+	for (unsigned int t = 1; t <= maxThreads; t <<= 1) {
+		path.clear();
+
+		const unsigned int t1 = SDL_GetTicks();
+		const bool found = search(minRad, maxRad, t, path);
+		const unsigned int dt = SDL_GetTicks() - t1;
+
+		if (t == 1) {
+			baseTime = std::max(dt, 1U);
+		}
+
+		printf(
+			"\t%2u threads: %5u msecs (speed-up %.2f), %u expanded, %u messages, path cost %.2f (%s)\n",
+			t, dt, float(baseTime) / std::max(dt, 1U), numExpanded, numMessages, pathCost, (found? "found": "failed")
+		);
+	}
+}
@@ -0,0 +1,135 @@
+#ifndef PARALLELSEARCH_HPP
+#define PARALLELSEARCH_HPP
+
+#include <vector>
+#include <queue>
+#include <atomic>
+#include <mutex>
+
+#include "../../Common/CommonTypes.hpp"
+#include "../../System/ThreadPool.hpp"
+
+// capacity (power of two) of every thread-pair message queue
+#define HDA_QUEUE_SIZE 512
+// expansions between two polls of the incoming queues
+#define HDA_EXPANSION_BATCH 16
+
+class ANode;
+class Node;
+class CPathFinder;
+
+// hash-distributed A* (HDA*) for a single large query: every
+// map node is owned by exactly one thread (chosen by a hash of
+// its index), and a thread that generates a successor it does
+// not own sends it to the owner through a lock-free queue
+//
+// the owner computes the successor's clearance with the same
+// CPathFinder::PathCanPass and weight logic as the sequential
+// search, so (other than for ties) both find the same paths
+//
+// the threads and the message queues are kept from one search
+// to the next as long as the number of threads stays the same
+class CParallelSearch {
+	public:
+		CParallelSearch(CPathFinder* pf);
+		~CParallelSearch();
+
+		// searches from pf->start to the nearest of pf->goals;
+		// on success <path> runs from the goal up to (but not
+		// including) the start, like AAStar::findPath
+		bool search(float minRad, float maxRad, unsigned int numThreads, std::vector<ANode*>& path);
+		// prints time, expansions and speed-up for 1, 2, 4, ...
+		// up to <maxThreads> threads on the current map
+		void Benchmark(float minRad, float maxRad, unsigned int maxThreads);
+
+		float GetPathCost() const { return pathCost; }
+		unsigned int GetNumExpanded() const { return numExpanded; }
+		unsigned int GetNumMessages() const { return numMessages; }
+
+	private:
+		struct Message {
+			int node;
+			int parent;
+			float parentG;
+		};
+
+		// bounded single-producer single-consumer ring
+		struct MessageQueue {
+			MessageQueue(): head(0), tail(0) {}
+
+			bool Push(const Message& m);
+			bool Pop(Message& m);
+
+			alignas(64) std::atomic<unsigned int> head;
+			alignas(64) std::atomic<unsigned int> tail;
+			Message ring[HDA_QUEUE_SIZE];
+		};
+
+		struct OpenEntry {
+			int node;
+			float f;
+			float g;
+
+			bool operator < (const OpenEntry& e) const {
+				if (f != e.f) return (f > e.f);
+				if (g != e.g) return (g < e.g);
+				return (node > e.node);
+			}
+		};
+
+		struct SearchThread {
+			std::priority_queue<OpenEntry> open;
+			// messages that did not fit into a full queue yet
+			std::vector< std::vector<Message> > outbox;
+
+			unsigned int numExpanded;
+			unsigned int numMessages;
+			bool busy;
+		};
+
+		void Run(unsigned int t);
+		void Receive(SearchThread& st, const Message& m);
+		void Expand(unsigned int t, const OpenEntry& e);
+		void Send(unsigned int t, unsigned int o, const Message& m);
+		// returns true if some messages are still waiting
+		bool FlushOutbox(unsigned int t);
+		void OnGoalReached(int node, float g);
+		float GoalDistance(const Node* n) const;
+
+		unsigned int Owner(int node) const { return (((unsigned int) node * 2654435761u) >> 8) % numThreads; }
+		MessageQueue& GetQueue(unsigned int from, unsigned int to) { return queues[from * numThreads + to]; }
+
+		CPathFinder* pf;
+		unsigned int numThreads;
+
+		// one thread (the caller included) per search thread:
+		// they wait on each other's messages, so every one of
+		// them has to run at the same time
+		CThreadPool pool;
+
+		// per-node search state, only ever written by the owner
+		std::vector<float> gs;
+		std::vector<float> hs;
+		std::vector<float> weights;
+		std::vector<int> parents;
+		std::vector<ubyte> states;
+
+		std::vector<SearchThread> threads;
+		MessageQueue* queues;
+
+		// messages sent but not yet received plus busy threads;
+		// the search is over once this drops to zero
+		std::atomic<int> work;
+
+		// cost of the best goal reached so far (entries whose f
+		// is not below it are never expanded)
+		std::atomic<float> incumbent;
+		std::mutex goalMutex;
+		int goalNode;
+
+		float pathCost;
+		unsigned int numExpanded;
+		unsigned int numMessages;
+};
+
+#endif
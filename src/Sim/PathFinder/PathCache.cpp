@@ -0,0 +1,110 @@
+#include <cmath>
+#include <algorithm>
+
+#include "./PathCache.hpp"
+#include "./Node.hpp"
+
+#define NODE(n) static_cast<Node*>(n)
+
+CPathCache::CPathCache(unsigned int maxEntries) {
+	this->maxEntries = std::max(maxEntries, 1U);
+
+	numHits = 0;
+	numMisses = 0;
+	numInvalidated = 0;
+	numBytes = 0;
+}
+
+const PathCacheEntry* CPathCache::Find(const PathCacheKey& key) {
+	std::map<PathCacheKey, EntryList::iterator>::iterator it = index.find(key);
+
+	if (it == index.end()) {
+		numMisses++;
+		return 0x0;
+	}
+
+	// iterators stay valid when splicing within a list
+	entries.splice(entries.begin(), entries, it->second);
+	numHits++;
+
+	return &(*it->second);
+}
+
+void CPathCache::Insert(const PathCacheKey& key, const std::vector<ANode*>& path, const std::vector<vec4>& curve, const std::vector<BoundingCircle>& tunnel) {
+	std::map<PathCacheKey, EntryList::iterator>::iterator it = index.find(key);
+
+	if (it != index.end()) {
+		Erase(it->second);
+	}
+	if (entries.size() >= maxEntries) {
+		Erase(--entries.end());
+	}
+
+	entries.push_front(PathCacheEntry());
+
+	PathCacheEntry& e = entries.front();
+	e.key = key;
+	e.path = path;
+	e.curve = curve;
+	e.tunnel = tunnel;
+
+	// PathCanPass looks up to maxRad nodes away from
+	// every path node, so edits out there matter too
+	const int R = int(ceilf(key.maxRad)) + 1;
+
+	e.minX = e.minY = e.minZ = 1 << 30;
+	e.maxX = e.maxY = e.maxZ = -(1 << 30);
+
+	for (unsigned int i = 0; i < path.size(); i++) {
+		const Node* n = NODE(path[i]);
+
+		e.minX = std::min(e.minX, n->x - R); e.maxX = std::max(e.maxX, n->x + R);
+		e.minY = std::min(e.minY, n->y - R); e.maxY = std::max(e.maxY, n->y + R);
+		e.minZ = std::min(e.minZ, n->z - R); e.maxZ = std::max(e.maxZ, n->z + R);
+	}
+
+	e.numBytes = sizeof(PathCacheEntry);
+	e.numBytes += path.size() * sizeof(ANode*);
+	e.numBytes += curve.size() * sizeof(vec4);
+
+	for (unsigned int i = 0; i < tunnel.size(); i++) {
+		const BoundingCircle& bc = tunnel[i];
+
+		e.numBytes += sizeof(BoundingCircle);
+		e.numBytes += (bc.vertices.size() + bc.segmentNormals.size() + bc.segmentDirects.size()) * sizeof(vec3);
+	}
+
+	numBytes += e.numBytes;
+	index[key] = entries.begin();
+}
+
+void CPathCache::InvalidateNode(int x, int y, int z) {
+	EntryList::iterator it = entries.begin();
+
+	while (it != entries.end()) {
+		const PathCacheEntry& e = *it;
+		const bool inside =
+			(x >= e.minX && x <= e.maxX) &&
+			(y >= e.minY && y <= e.maxY) &&
+			(z >= e.minZ && z <= e.maxZ);
+
+		if (inside) {
+			numInvalidated++;
+			Erase(it++);
+		} else {
+			++it;
+		}
+	}
+}
+
+void CPathCache::Clear() {
+	entries.clear();
+	index.clear();
+	numBytes = 0;
+}
+
+void CPathCache::Erase(EntryList::iterator it) {
+	numBytes -= it->numBytes;
+	index.erase(it->key);
+	entries.erase(it);
+}
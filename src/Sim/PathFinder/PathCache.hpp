@@ -0,0 +1,87 @@
+#ifndef PATHCACHE_HPP
+#define PATHCACHE_HPP
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include "../../Math/vec3.hpp"
+#include "../ParticleSystem/BoundingCircle.hpp"
+
+class ANode;
+
+struct PathCacheKey {
+	int sId;
+	int gId;
+	float minRad;
+	float maxRad;
+	unsigned int mapVersion;
+	// which of several equally short paths is found, and
+	// whether it may be confined to a coarse corridor (and
+	// so not be the shortest at all)
+	int tieBreak;
+	bool coarseToFine;
+
+	bool operator < (const PathCacheKey& k) const {
+		if (sId != k.sId) return (sId < k.sId);
+		if (gId != k.gId) return (gId < k.gId);
+		if (minRad != k.minRad) return (minRad < k.minRad);
+		if (maxRad != k.maxRad) return (maxRad < k.maxRad);
+		if (mapVersion != k.mapVersion) return (mapVersion < k.mapVersion);
+		if (tieBreak != k.tieBreak) return (tieBreak < k.tieBreak);
+		return (coarseToFine < k.coarseToFine);
+	}
+};
+
+// a finished search: the path as CPathFinder::search leaves
+// it plus the curve and tunnel derived from it, and the box
+// (grown by the clearance radius) whose contents decided it
+struct PathCacheEntry {
+	PathCacheKey key;
+
+	std::vector<ANode*> path;
+	std::vector<vec4> curve;
+	std::vector<BoundingCircle> tunnel;
+
+	int minX, minY, minZ;
+	int maxX, maxY, maxZ;
+	unsigned int numBytes;
+};
+
+// bounded LRU cache of finished searches; an edit of a single
+// node drops only the entries whose box contains it (the other
+// paths remain passable, but need no longer be the shortest)
+class CPathCache {
+	public:
+		CPathCache(unsigned int maxEntries);
+
+		// moves a hit to the front, returns 0x0 on a miss
+		const PathCacheEntry* Find(const PathCacheKey& key);
+		void Insert(const PathCacheKey& key, const std::vector<ANode*>& path, const std::vector<vec4>& curve, const std::vector<BoundingCircle>& tunnel);
+		void InvalidateNode(int x, int y, int z);
+		void Clear();
+
+		unsigned int GetNumEntries() const { return entries.size(); }
+		unsigned int GetNumHits() const { return numHits; }
+		unsigned int GetNumMisses() const { return numMisses; }
+		unsigned int GetNumInvalidated() const { return numInvalidated; }
+		unsigned int GetMemoryUsage() const { return numBytes; }
+		float GetHitRate() const { return ((numHits + numMisses) > 0)? float(numHits) / (numHits + numMisses): 0.0f; }
+
+	private:
+		typedef std::list<PathCacheEntry> EntryList;
+
+		void Erase(EntryList::iterator it);
+
+		unsigned int maxEntries;
+		unsigned int numHits;
+		unsigned int numMisses;
+		unsigned int numInvalidated;
+		unsigned int numBytes;
+
+		// most recently used first
+		EntryList entries;
+		std::map<PathCacheKey, EntryList::iterator> index;
+};
+
+#endif
@@ -1,15 +1,16 @@
 #include "./PathFinder.hpp"
-#include "./PathFollower.hpp"
+#include "./PathWorker.hpp"
+#include "./FlowField.hpp"
 #include "../../Math/RNG.hpp"
 #include "../../Math/Trig.hpp"
 #include "../../Math/Interpolators.hpp"
 #include "../../System/ScopedTimer.hpp"
+#include "../../System/AllocProbe.hpp"
 #include <math.h>
 
-#define NODE(n) dynamic_cast<Node*>(n)
-PathFollower pathFollower;
+#define NODE(n) static_cast<Node*>(n)
 
-CPathFinder::CPathFinder(int X, int Y, int Z) {
+CPathFinder::CPathFinder(int X, int Y, int Z, CVersionedMap* sharedMap): queryArena(QUERY_ARENA_SIZE), goalBuckets(&queryArena) {
 	this->X = X;
 	this->Y = Y;
 	this->Z = Z;
@@ -28,15 +29,63 @@ CPathFinder::CPathFinder(int X, int Y, int Z) {
 	showVisitedNodes = false;
 	showBackBonePath = true;
 	step = 0;
+	connectivity = 26;
+	hType = HEURISTIC_EUCLIDEAN;
+	minRad = maxRad = 0.0f;
+	cType = CONSTRAINT_NONE;
+	corridorStamp = 0;
+	coarseToFine = false;
+	pyramidVersion = 0;
+	pyramid = new COccupancyPyramid(this);
+	flowField = 0x0;
+	pathWorker = 0x0;
+	coarseSearch = new CPyramidSearch(pyramid);
+	pathCache = new CPathCache(PATHCACHESIZE);
+	mapVersion = 0;
+	usePathCache = true;
+	goalTree = new CGoalTree(this);
+	useGoalTree = false;
+	versionedMap = (sharedMap != 0x0)? sharedMap: new CVersionedMap(X, Y, Z);
+	ownsVersionedMap = (sharedMap == 0x0);
+	pinnedSnapshot = 0x0;
+	pinnedSlot = -1;
+
 	// how badly do we want to explore (find the largest tunnel)?
 	radialScalar = 0.9f;
+
+	GenerateDistanceTable();
+}
+
+CPathFinder::~CPathFinder() {
+	delete pathCache; pathCache = 0x0;
+	delete goalTree; goalTree = 0x0;
+	if (ownsVersionedMap) {
+		delete versionedMap; versionedMap = 0x0;
+	}
+	delete coarseSearch; coarseSearch = 0x0;
+	delete pyramid; pyramid = 0x0;
 }
 
 void CPathFinder::toggleBlocked(int x, int y, int z) {
 	map[id(x, y, z)].toggleBlocked();
+	BlockChanged(x, y, z);
+}
+
+void CPathFinder::BlockChanged(int x, int y, int z) {
+	versionedMap->SetBlocked(x, y, z, map[id(x, y, z)].blocked());
+	pyramid->UpdateBlock(x, y, z);
+	pathCache->InvalidateNode(x, y, z);
+
+	if (flowField != 0x0) {
+		flowField->UpdateBlock(x, y, z);
+	}
 }
 
 void CPathFinder::GenerateSphereBlockOffsets() {
+	GenerateSphereBlockOffsets(maxRad, sphereBlockOffsets);
+}
+
+void CPathFinder::GenerateSphereBlockOffsets(float maxRad, std::vector<SphereBlockOffset>& sphereBlockOffsets) const {
 	sphereBlockOffsets.clear();
 
 	// generate a list of XYZ-offsets of blocks (nodes)
@@ -68,9 +117,35 @@ void CPathFinder::GenerateSphereBlockOffsets() {
 	}
 }
 
+void CPathFinder::GenerateDistanceTable() {
+	const int maxSqLen = ((X - 1) * (X - 1)) + ((Y - 1) * (Y - 1)) + ((Z - 1) * (Z - 1));
+
+	sqrtTable.resize(maxSqLen + 1);
+
+	for (int i = 0; i <= maxSqLen; i++) {
+		sqrtTable[i] = sqrt(i);
+	}
+}
+
+
+void CPathFinder::successors(ANode* an, NodeList& succ) {
+	Node* nbrs[26];
+	const int numNbrs = GetNeighbours(NODE(an), nbrs);
 
-void CPathFinder::successors(ANode* an, std::queue<ANode*>& succ) {
-	Node *s = 0x0, *n = NODE(an);
+	for (int i = 0; i < numNbrs; i++) {
+		Node* s = nbrs[i];
+
+		// can our corridor pass this successor
+		// without shrinking to less than minRad?
+		if (PathCanPass(s)) {
+			s->w = NodeWeight(s);
+			succ.push_back(s);
+		}
+	}
+}
+
+int CPathFinder::GetNeighbours(const Node* n, Node** nbrs) {
+	int numNbrs = 0;
 	int x, y, z;
 
 	for (int i = -1; i <= 1; i++) {
@@ -79,26 +154,52 @@ void CPathFinder::successors(ANode* an, std::queue<ANode*>& succ) {
 				// don't add the parent node
 				if (k == 0 && j == 0 && i == 0)
 					continue;
+				// 6: faces only, 18: faces and edges, 26: all
+				if ((i * i + j * j + k * k) > 1 && connectivity ==  6)
+					continue;
+				if ((i * i + j * j + k * k) > 2 && connectivity == 18)
+					continue;
 
 				x = n->x + i; y = n->y + j; z = n->z + k;
 
 				// check if we are within boundaries
 				if (x < X && x >= 0 && y < Y && y >= 0 && z < Z && z >= 0) {
-					s = &map[id(x, y, z)];
+					if (!InSearchSpace(x, y, z))
+						continue;
 
-					// can our corridor pass this successor
-					// without shrinking to less than minRad?
-					if (PathCanPass(s)) {
-						s->w = radialScalar * ((1.0f - s->radius / maxRad) + 1.0f);
-						succ.push(s);
-					}
+					nbrs[numNbrs++] = &map[id(x, y, z)];
 				}
 			}
 		}
 	}
+
+	return numNbrs;
 }
 
 bool CPathFinder::PathCanPass(Node* sn) {
+	return (PathCanPass(sn, minRad, maxRad, sphereBlockOffsets, &sn->radius));
+}
+
+bool CPathFinder::PathCanPass(const Node* sn, float minRad, float maxRad, const std::vector<SphereBlockOffset>& sphereBlockOffsets, float* radius) const {
+	const CMapSnapshot* ms = (pinnedSnapshot != 0x0)? pinnedSnapshot: versionedMap->GetCurrent();
+
+	if (!sphereBlockOffsets.empty()) {
+		// if the node is far enough from the world's boundaries
+		// for every offset to pass the bounds-check below and no
+		// offset can hit an obstacle, the balloon inflates fully
+		const int M = int(ceilf(maxRad));
+
+		const bool interior =
+			(sn->x >= 2 * M && sn->x <= X - 2 * M) &&
+			(sn->y >= 2 * M && sn->y <= Y - 2 * M) &&
+			(sn->z >= 2 * M && sn->z <= Z - 2 * M);
+
+		if (interior && ms->IsRegionEmpty(sn->x - M, sn->y - M, sn->z - M, sn->x + M, sn->y + M, sn->z + M)) {
+			*radius = sphereBlockOffsets.back().r;
+			return true;
+		}
+	}
+
 	for (unsigned int i = 0; i < sphereBlockOffsets.size(); i++) {
 		// "blow up the balloon" around this successor node:
 		// for each offset block around <sn>, check if that
@@ -112,12 +213,11 @@ bool CPathFinder::PathCanPass(Node* sn) {
 		int z = sbo.z + sn->z; bool b3 = (z <= Z - B && z >= B);
 
 		if (b1 && b2 && b3) {
-			Node* o = &map[id(x, y, z)];
-			sn->radius = r;
+			*radius = r;
 
-			if (o->blocked()) {
+			if (ms->IsBlocked(x, y, z)) {
 				r -= RADIALSTEP;
-				sn->radius = r;
+				*radius = r;
 
 				if (r < minRad - EPSILON)
 					return false;
@@ -125,7 +225,7 @@ bool CPathFinder::PathCanPass(Node* sn) {
 			}
 		} else {
 			r -= RADIALSTEP;
-			sn->radius = r;
+			*radius = r;
 
 			if (r < minRad - EPSILON)
 				return false;
@@ -139,25 +239,306 @@ bool CPathFinder::PathCanPass(Node* sn) {
 float CPathFinder::heuristic(ANode* an1, ANode* an2) {
 	const Node* n1 = NODE(an1);
 	const Node* n2 = NODE(an2);
-	const int dx = abs(n1->x - n2->x);
-	const int dy = abs(n1->y - n2->y);
-	const int dz = abs(n1->z - n2->z);
-	return sqrt(dx*dx + dy*dy + dz*dz);
+	return distance(n1->x - n2->x, n1->y - n2->y, n1->z - n2->z);
+}
+
+bool CPathFinder::isGoal(ANode* an) {
+	return (NODE(an)->bType == GOAL);
+}
+
+float CPathFinder::goalHeuristic(ANode* an) {
+	if (goals.size() <= 1) {
+		return heuristic(an, goal);
+	}
+
+	const Node* n = NODE(an);
+	float minDist = 1e30f;
+
+	for (unsigned int i = 0; i < goalBuckets.size(); i++) {
+		const GoalBucket& gb = goalBuckets[i];
+
+		// distance to the bucket's bounding box is a lower
+		// bound on the distance to any goal inside it
+		const int dx = std::max(0, std::max(gb.minX - n->x, n->x - gb.maxX));
+		const int dy = std::max(0, std::max(gb.minY - n->y, n->y - gb.maxY));
+		const int dz = std::max(0, std::max(gb.minZ - n->z, n->z - gb.maxZ));
+
+		if (distance(dx, dy, dz) >= minDist)
+			continue;
+
+		for (unsigned int j = 0; j < gb.goals.size(); j++) {
+			const Node* g = gb.goals[j];
+			minDist = std::min(minDist, distance(n->x - g->x, n->y - g->y, n->z - g->z));
+		}
+	}
+
+	return minDist;
+}
+
+float CPathFinder::distance(int dx, int dy, int dz) const {
+	if (hType == HEURISTIC_EUCLIDEAN) {
+		return sqrtTable[dx*dx + dy*dy + dz*dz];
+	}
+
+	// sort the absolute deltas such that a >= b >= c
+	int a = (dx < 0)? -dx: dx;
+	int b = (dy < 0)? -dy: dy;
+	int c = (dz < 0)? -dz: dz;
+	int t;
+
+	if (a < b) { t = a; a = b; b = t; }
+	if (b < c) { t = b; b = c; c = t; }
+	if (a < b) { t = a; a = b; b = t; }
+
+	switch (connectivity) {
+		case 6: {
+			return float(a + b + c);
+		} break;
+		case 18: {
+			// every edge-diagonal step covers two axes at once
+			if (a >= b + c)
+				return ((b + c) * SQRT2) + (a - b - c);
+
+			return (((a + b + c) >> 1) * SQRT2) + ((a + b + c) & 1);
+		} break;
+	}
+
+	// c corner-diagonal steps, (b - c) edge-diagonal
+	// steps and (a - b) straight steps
+	return (a + (b * (SQRT2 - 1.0f)) + (c * (SQRT3 - SQRT2)));
+}
+
+void CPathFinder::BenchmarkHeuristic(unsigned int numSamples) {
+	// number of random node pairs to cycle through (power of two)
+	static const unsigned int NUM_PAIRS = 4096;
+	static const unsigned int PAIR_MASK = (NUM_PAIRS * 2) - 1;
+
+	const heuristicType oldType = hType;
+	std::vector<ANode*> pairs(NUM_PAIRS * 2);
+	float sums[3] = {0.0f, 0.0f, 0.0f};
+
+	for (unsigned int i = 0; i < pairs.size(); i++) {
+		pairs[i] = &map[rng.RandInt(map.size() - 1)];
+	}
+
+	{
+		// the pre-table heuristic, for reference
+		ScopedTimer t("CPathFinder::BenchmarkHeuristic() [sqrt]");
+
+		for (unsigned int i = 0; i < numSamples; i++) {
+			const Node* n1 = dynamic_cast<Node*>(pairs[((i << 1)    ) & PAIR_MASK]);
+			const Node* n2 = dynamic_cast<Node*>(pairs[((i << 1) + 1) & PAIR_MASK]);
+			const int dx = abs(n1->x - n2->x);
+			const int dy = abs(n1->y - n2->y);
+			const int dz = abs(n1->z - n2->z);
+			sums[0] += sqrt(dx*dx + dy*dy + dz*dz);
+		}
+	}
+
+	hType = HEURISTIC_EUCLIDEAN;
+
+	{
+		ScopedTimer t("CPathFinder::BenchmarkHeuristic() [table]");
+
+		for (unsigned int i = 0; i < numSamples; i++) {
+			sums[1] += heuristic(pairs[((i << 1)    ) & PAIR_MASK], pairs[((i << 1) + 1) & PAIR_MASK]);
+		}
+	}
+
+	hType = HEURISTIC_GRID;
+
+	{
+		ScopedTimer t("CPathFinder::BenchmarkHeuristic() [grid]");
+
+		for (unsigned int i = 0; i < numSamples; i++) {
+			sums[2] += heuristic(pairs[((i << 1)    ) & PAIR_MASK], pairs[((i << 1) + 1) & PAIR_MASK]);
+		}
+	}
+
+	hType = oldType;
+
+	// also keeps the loops from being optimized away
+	printf("%u samples, connectivity %d, sums: %.1f %.1f %.1f\n", numSamples, connectivity, sums[0], sums[1], sums[2]);
+}
+
+
+void CPathFinder::SetSearchRegion(int minX, int minY, int minZ, int maxX, int maxY, int maxZ) {
+	cType = CONSTRAINT_REGION;
+	cMinX = std::max(minX, 0); cMaxX = std::min(maxX, X - 1);
+	cMinY = std::max(minY, 0); cMaxY = std::min(maxY, Y - 1);
+	cMinZ = std::max(minZ, 0); cMaxZ = std::min(maxZ, Z - 1);
+}
+
+void CPathFinder::SetSearchCorridor(const std::vector<ANode*>& corridorPath, int width) {
+	if (corridorPath.empty()) {
+		cType = CONSTRAINT_NONE;
+		return;
+	}
+
+	BeginCorridor();
+
+	for (unsigned int i = 0; i < corridorPath.size(); i++) {
+		const Node* n = NODE(corridorPath[i]);
+		StampCorridorBox(n->x - width, n->y - width, n->z - width, n->x + width, n->y + width, n->z + width);
+	}
+}
+
+void CPathFinder::BeginCorridor() {
+	if (corridorStamps.empty()) {
+		corridorStamps.resize(map.size(), 0);
+	}
+
+	// a new stamp invalidates the previous corridor without
+	// touching anything outside the new one
+	if ((++corridorStamp) == 0) {
+		corridorStamps.assign(map.size(), 0);
+		corridorStamp = 1;
+	}
+
+	cType = CONSTRAINT_CORRIDOR;
+	cMinX = X; cMaxX = -1;
+	cMinY = Y; cMaxY = -1;
+	cMinZ = Z; cMaxZ = -1;
+}
+
+void CPathFinder::StampCorridorBox(int x0, int y0, int z0, int x1, int y1, int z1) {
+	x0 = std::max(x0, 0); x1 = std::min(x1, X - 1);
+	y0 = std::max(y0, 0); y1 = std::min(y1, Y - 1);
+	z0 = std::max(z0, 0); z1 = std::min(z1, Z - 1);
+
+	for (int x = x0; x <= x1; x++) {
+		for (int y = y0; y <= y1; y++) {
+			for (int z = z0; z <= z1; z++) {
+				corridorStamps[id(x, y, z)] = corridorStamp;
+			}
+		}
+	}
+
+	cMinX = std::min(cMinX, x0); cMaxX = std::max(cMaxX, x1);
+	cMinY = std::min(cMinY, y0); cMaxY = std::max(cMaxY, y1);
+	cMinZ = std::min(cMinZ, z0); cMaxZ = std::max(cMaxZ, z1);
+}
+
+bool CPathFinder::BuildCoarseCorridor() {
+	const bool stale = (!ownsVersionedMap && pinnedSnapshot->GetVersion() != pyramidVersion);
+
+	if (!pyramid->IsBuilt(minRad, maxRad) || stale) {
+		ScopedTimer t("COccupancyPyramid::Build()");
+		pyramid->Build(minRad, maxRad);
+		pyramidVersion = pinnedSnapshot->GetVersion();
+	}
+
+	const int level = pyramid->GetCoarseLevel();
+
+	if (level == 0) {
+		return false;
+	}
+
+	std::vector<ANode*> coarsePath;
+
+	if (!coarseSearch->search(level, NODE(start), NODE(goal), minRad, coarsePath)) {
+		return false;
+	}
+
+	// the coarse path excludes its start cell
+	coarsePath.push_back(coarseSearch->start);
+
+	BeginCorridor();
+
+	// band of one coarse cell around every cell on the path
+	for (unsigned int i = 0; i < coarsePath.size(); i++) {
+		const Node* c = NODE(coarsePath[i]);
+
+		StampCorridorBox(
+			(c->x - 1) << level, (c->y - 1) << level, (c->z - 1) << level,
+			((c->x + 2) << level) - 1, ((c->y + 2) << level) - 1, ((c->z + 2) << level) - 1
+		);
+	}
+
+	return true;
 }
 
 
 void CPathFinder::setStart(int x, int y, int z) {
 	sId = id(x, y, z);
 	Node* s = &map[sId];
+
+	const bool wasBlocked = s->blocked();
+
 	s->setStart();
 	start = s;
+
+	if (wasBlocked) {
+		BlockChanged(x, y, z);
+	}
 }
 
 void CPathFinder::setGoal(int x, int y, int z) {
-	gId = id(x, y, z);
-	Node* g = &map[gId];
+	clearGoals();
+	addGoal(x, y, z);
+}
+
+void CPathFinder::addGoal(int x, int y, int z) {
+	Node* g = &map[id(x, y, z)];
+
+	const bool wasBlocked = g->blocked();
+
 	g->setGoal();
-	goal = g;
+	goals.push_back(g);
+
+	if (wasBlocked) {
+		BlockChanged(x, y, z);
+	}
+
+	if (goals.size() == 1) {
+		gId = g->id;
+		goal = g;
+	}
+}
+
+void CPathFinder::clearGoals() {
+	for (unsigned int i = 0; i < goals.size(); i++) {
+		if (goals[i]->bType == GOAL) {
+			goals[i]->bType = NORMAL;
+		}
+	}
+
+	goals.clear();
+	goalBuckets.clear();
+}
+
+void CPathFinder::BuildGoalIndex() {
+	// let go of the last index before the arena is rewound
+	goalBuckets = std::pmr::vector<GoalBucket>(&queryArena);
+	queryArena.Reset();
+
+	// cell key ==> index into goalBuckets
+	std::pmr::map<int, unsigned int> cells(&queryArena);
+
+	for (unsigned int i = 0; i < goals.size(); i++) {
+		Node* g = goals[i];
+
+		const int cx = g->x / GOALCELLSIZE;
+		const int cy = g->y / GOALCELLSIZE;
+		const int cz = g->z / GOALCELLSIZE;
+		const int key = id(cx, cy, cz);
+
+		if (cells.find(key) == cells.end()) {
+			cells[key] = goalBuckets.size();
+			goalBuckets.emplace_back(&queryArena);
+
+			GoalBucket& gb = goalBuckets.back();
+			gb.minX = gb.maxX = g->x;
+			gb.minY = gb.maxY = g->y;
+			gb.minZ = gb.maxZ = g->z;
+		}
+
+		GoalBucket& gb = goalBuckets[cells[key]];
+		gb.minX = std::min(gb.minX, g->x); gb.maxX = std::max(gb.maxX, g->x);
+		gb.minY = std::min(gb.minY, g->y); gb.maxY = std::max(gb.maxY, g->y);
+		gb.minZ = std::min(gb.minZ, g->z); gb.maxZ = std::max(gb.maxZ, g->z);
+		gb.goals.push_back(g);
+	}
 }
 
 
@@ -167,6 +548,7 @@ void CPathFinder::Reset() {
 	blocked.clear();
 	curve.clear();
 	tunnel.clear();
+	tunnelTables.Clear();
 	init();
 
 	step = 0;
@@ -175,6 +557,15 @@ void CPathFinder::Reset() {
 		map[i].bType = NORMAL;
 	}
 
+	pyramid->Invalidate();
+	pathCache->Clear();
+	goalTree->Clear();
+	mapVersion++;
+
+	if (flowField != 0x0) {
+		flowField->Invalidate();
+	}
+
 	for (int g = 6; g < X - 6; g++) {
 		for (int h = 0; h < 3; h++) {
 			int ry = rng.RandInt(Y - 1);
@@ -202,6 +593,8 @@ void CPathFinder::Reset() {
 		}
 	}
 
+	versionedMap->Rebuild(map);
+
 	int sx = 3;
 	int sy = rng.RandInt(Y - 4) + 2;
 	int sz = rng.RandInt(Z - 4) + 2;
@@ -216,23 +609,105 @@ void CPathFinder::Reset() {
 }
 
 void CPathFinder::search(float minRad, float maxRad) {
+	SearchTask t = searchTask(minRad, maxRad, SearchBudget());
+
+	while (t.Resume()) {
+	}
+}
+
+SearchTask CPathFinder::searchTask(float minRad, float maxRad, SearchBudget budget) {
 	if (!canSearch) {
-		return;
+		co_return false;
 	}
 
-	this->minRad = minRad;
-	this->maxRad = maxRad;
 	canSearch = false;
-	GenerateSphereBlockOffsets();
+	SetSearchRadii(minRad, maxRad);
+	BuildGoalIndex();
 
-	// push goal since interpolation occurs between point b and c (goal = a)
-	path.push_back(goal);
+	// a constrained (or multi-goal) result depends on more than the key
+	const bool cacheable = (usePathCache && cType == CONSTRAINT_NONE && goals.size() == 1);
+	const PathCacheKey key = {sId, gId, minRad, maxRad, mapVersion, int(GetTieBreakPolicy()), coarseToFine};
 
-	{
+	if (cacheable) {
+		const PathCacheEntry* e = pathCache->Find(key);
+
+		if (e != 0x0) {
+			printf("[CPathFinder::search] cache hit (hit-rate %.2f, %u entries, %u bytes)\n", pathCache->GetHitRate(), pathCache->GetNumEntries(), pathCache->GetMemoryUsage());
+
+			trace.Begin();
+			RestoreResult(e->path, e->curve, e->tunnel);
+			co_return true;
+		}
+	}
+
+	SnapshotPin pin(this);
+	SearchSlice slice(budget);
+	searchState s = SEARCH_FAILED;
+
+	if (useGoalTree && cType == CONSTRAINT_NONE && goals.size() == 1) {
 		ScopedTimer t("CPathFinder::findPath()");
-		findPath(path);
+
+		const GoalTreeKey treeKey = {int(goal->id), minRad, maxRad, mapVersion, pinnedSnapshot->GetVersion()};
+
+		// nothing is opened if the start is settled already
+		trace.Begin();
+		goalTree->BeginQuery(treeKey, sId);
+		slice.Begin(goalTree->GetNumExpanded());
+
+		while ((s = goalTree->Step()) == SEARCH_RUNNING) {
+			if (slice.Expired(goalTree->GetNumExpanded())) {
+				co_yield goalTree->GetNumExpanded();
+				slice.Begin(goalTree->GetNumExpanded());
+			}
+		}
+
+		if (s == SEARCH_FOUND) {
+			goalTree->TracePath(path);
+
+#if (SEARCH_TRACE == 1)
+			for (unsigned int i = 0; i < path.size() && trace.IsOn(); i++) {
+				trace.RecordPath(path[i]->id);
+			}
+#endif
+		}
+	} else {
+		ScopedTimer t("CPathFinder::findPath()");
+
+		// only when no other constraint (or several goals) is set
+		const bool coarse = (coarseToFine && cType == CONSTRAINT_NONE && goals.size() == 1 && BuildCoarseCorridor());
+		const constraintType oldType = cType;
+
+		while (true) {
+			beginSearch();
+			slice.Begin(0);
+
+			while ((s = searchStep(path)) == SEARCH_RUNNING) {
+				if (slice.Expired(GetSearchStats().numExpanded)) {
+					co_yield GetSearchStats().numExpanded;
+					slice.Begin(GetSearchStats().numExpanded);
+				}
+			}
+
+			if (s == SEARCH_FOUND || cType == CONSTRAINT_NONE)
+				break;
+
+			// nothing inside the region, fall back to the full grid
+			cType = CONSTRAINT_NONE;
+		}
+
+		cType = oldType;
+
+		if (coarse) {
+			cType = CONSTRAINT_NONE;
+		}
 	}
 
+	// with multiple goals, findPath() sets <goal> to the one reached
+	gId = goal->id;
+
+	// push goal since interpolation occurs between point b and c (goal = a)
+	path.insert(path.begin(), goal);
+
 	// push start since it's never in the path
 	path.push_back(start);
 	// push start again since interpolation occurs between point b and c (start = d)
@@ -242,6 +717,173 @@ void CPathFinder::search(float minRad, float maxRad) {
 		BuildPathCurve(0.05f);
 		BuildTunnel();
 	}
+
+	// only paths: a failure's box holds just its endpoints, so
+	// an edit that opens a way elsewhere would never evict it
+	if (cacheable && s == SEARCH_FOUND) {
+		pathCache->Insert(key, path, curve, tunnel);
+	}
+
+	co_return (s == SEARCH_FOUND);
+}
+
+void CPathFinder::BenchmarkSuspension(float minRad, float maxRad, unsigned int numRuns) {
+	// expansions per slice (0: never suspend)
+	static const unsigned int budgets[] = {0, 4096, 256, 16, 1};
+
+	std::vector<ANode*> p;
+	unsigned int t0 = 0;
+	unsigned int tPlain = 0;
+
+	SetSearchRadii(minRad, maxRad);
+	BuildGoalIndex();
+	SetVerbose(false);
+
+	t0 = SDL_GetTicks();
+
+	for (unsigned int i = 0; i < numRuns; i++) {
+		p.clear();
+		findPath(p);
+	}
+
+	tPlain = SDL_GetTicks() - t0;
+
+	printf("[CPathFinder::BenchmarkSuspension] %u searches, %u expansions each\n", numRuns, GetSearchStats().numExpanded);
+	printf("\tplain loop: %u msecs\n", tPlain);
+
+	for (unsigned int b = 0; b < (sizeof(budgets) / sizeof(budgets[0])); b++) {
+		unsigned int numSuspensions = 0;
+
+		t0 = SDL_GetTicks();
+
+		for (unsigned int i = 0; i < numRuns; i++) {
+			p.clear();
+
+			SearchTask t = findPathTask(p, SearchBudget(budgets[b]));
+
+			while (t.Resume()) {
+			}
+
+			numSuspensions += t.GetNumSuspensions();
+		}
+
+		const unsigned int tTask = SDL_GetTicks() - t0;
+		// relative to the plain loop, within timer noise for a
+		// few hundred nsecs per suspension
+		const float overhead = (tPlain > 0)? ((float(tTask) / tPlain) - 1.0f) * 100.0f: 0.0f;
+
+		printf("\ttask, %4u expansions per slice: %u msecs, %u suspensions (%+.1f%%)\n", budgets[b], tTask, numSuspensions, overhead);
+	}
+
+	printf("\tframes that did not fit the arena: %u\n", GetFrameArena()->GetNumHeapFrames());
+
+	SetVerbose(true);
+}
+
+void CPathFinder::BenchmarkCoarseToFine(int size, float minRad, float maxRad, unsigned int numRuns) {
+	// full search, first coarse-to-fine search on a map (with
+	// the pyramid build) and a repeated one (pyramid built)
+	static const char* names[] = {"full grid", "coarse-to-fine, first", "coarse-to-fine"};
+
+	CPathFinder pf(size, size, size);
+	unsigned int times[3] = {0, 0, 0};
+	unsigned int numExpanded[3] = {0, 0, 0};
+	unsigned int numFound[3] = {0, 0, 0};
+	float costs[3] = {0.0f, 0.0f, 0.0f};
+
+	// every query has to be searched
+	pf.SetPathCaching(false);
+	pf.SetVerbose(false);
+
+	printf("[CPathFinder::BenchmarkCoarseToFine] %d^3 nodes, %u maps\n", size, numRuns);
+
+	for (unsigned int i = 0; i < numRuns; i++) {
+		// a new map, and a goal across it from the start
+		pf.Reset();
+		pf.setGoal(size - 4, rng.RandInt(size - 4) + 2, rng.RandInt(size - 4) + 2);
+
+		for (unsigned int m = 0; m < 3; m++) {
+			pf.SetCoarseToFine(m > 0);
+			pf.canSearch = true;
+			pf.path.clear();
+			pf.curve.clear();
+			pf.tunnel.clear();
+
+			const unsigned int t0 = SDL_GetTicks();
+			pf.search(minRad, maxRad);
+			times[m] += (SDL_GetTicks() - t0);
+
+			if (pf.path.size() > 3) {
+				numExpanded[m] += pf.GetSearchStats().numExpanded;
+				numFound[m] += 1;
+				costs[m] += pf.goal->g;
+			}
+		}
+	}
+
+	for (unsigned int m = 0; m < 3; m++) {
+		// the corridor can cut off the optimal path, compare costs
+		const float costRatio = (costs[0] > 0.0f)? (costs[m] / costs[0]): 0.0f;
+
+		printf("\t%-22s %6.1f msecs per search, %u found, %u expansions, cost x%.3f\n", names[m], float(times[m]) / numRuns, numFound[m], numExpanded[m], costRatio);
+	}
+}
+
+void CPathFinder::ProbeAllocations(float minRad, float maxRad, unsigned int numRuns) {
+	const bool caching = usePathCache;
+	const unsigned int numBlocks = GetSearchArena()->GetNumBlockAllocs();
+
+	std::vector<ANode*> p;
+
+	// a cache hit would skip the work being probed
+	usePathCache = false;
+	SetVerbose(false);
+
+	printf("[CPathFinder::ProbeAllocations] %u runs\n", numRuns);
+
+	// the probes count every thread; nothing new can be queued
+	// while this one is busy here
+	if (pathWorker != 0x0) {
+		pathWorker->WaitIdle();
+	}
+
+	for (unsigned int i = 0; i < numRuns; i++) {
+		unsigned int numSearchAllocs = 0;
+		unsigned int numQueryAllocs = 0;
+
+		{
+			AllocProbe probe;
+			p.clear();
+			findPath(p);
+			numSearchAllocs = probe.GetCount();
+		}
+		{
+			AllocProbe probe;
+			canSearch = true;
+			path.clear();
+			curve.clear();
+			tunnel.clear();
+			tunnelTables.Clear();
+			search(minRad, maxRad);
+			numQueryAllocs = probe.GetCount();
+		}
+
+		printf("\trun %u: findPath %u allocations, search %u allocations (%u tunnel slices)\n", i, numSearchAllocs, numQueryAllocs, unsigned(tunnel.size()));
+	}
+
+	printf("\tsearch arena: %u blocks added, %u bytes\n", GetSearchArena()->GetNumBlockAllocs() - numBlocks, unsigned(GetSearchArena()->GetCapacity()));
+
+	usePathCache = caching;
+	SetVerbose(true);
+}
+
+void CPathFinder::SetSearchRadii(float minRad, float maxRad) {
+	if (minRad == this->minRad && maxRad == this->maxRad && !sphereBlockOffsets.empty())
+		return;
+
+	this->minRad = minRad;
+	this->maxRad = maxRad;
+	GenerateSphereBlockOffsets();
 }
 
 void CPathFinder::BuildPathCurve(float muStep) {
@@ -250,6 +892,11 @@ void CPathFinder::BuildPathCurve(float muStep) {
 
 	pathFollower.Init();
 
+	// every segment takes at most this many steps of <muStep>
+	if (path.size() > 3) {
+		curve.reserve(curve.size() + (path.size() - 3) * (int(1.0f / muStep) + 2));
+	}
+
 	for (unsigned int i = 3; i < path.size(); i++) {
 		Node* a = NODE(path[i - 3]);
 		Node* b = NODE(path[i - 2]);
@@ -276,17 +923,51 @@ void CPathFinder::BuildPathCurve(float muStep) {
 }
 
 void CPathFinder::BuildTunnel() {
+	tunnel.reserve(tunnel.size() + curve.size());
+
 	for (unsigned int i = 1; i < curve.size(); i++) {
 		const vec4& p0 = curve[i - 1];
 		const vec4& p1 = curve[i    ];
 		const vec3 n = (p1 - p0).norm();
 		const float r = p0.w;
 
-		BoundingCircle bc(p0, n, 16, r);
-		tunnel.push_back(bc);
+		tunnel.emplace_back(p0, n, 16, r);
+	}
+
+	tunnelTables.Build(tunnel);
+}
+
+
+void CPathFinder::RestoreResult(const std::vector<ANode*>& p, const std::vector<vec4>& c, const std::vector<BoundingCircle>& t) {
+	path = p;
+	curve = c;
+	tunnel = t;
+	tunnelTables.Build(tunnel);
+
+	// same state BuildPathCurve leaves the follower in
+	pathFollower.Init();
+
+	if (path.size() > 4) {
+		pathFollower.Init(curve[0], 1);
 	}
 }
 
+bool CPathFinder::ApplyResult(const CPathResult& r) {
+	if (r.mapVersion != mapVersion || r.sId != sId)
+		return false;
+	// the path may cross voxels blocked in the meantime
+	if (r.snapshotVersion != versionedMap->GetCurrent()->GetVersion())
+		return false;
+
+	canSearch = false;
+	gId = r.gId;
+	goal = &map[gId];
+	trace.Replay(r.trace);
+
+	RestoreResult(r.path, r.curve, r.tunnel);
+	return true;
+}
+
 
 void CPathFinder::update() {
 	if (!canSearch) {
@@ -6,57 +6,242 @@
 
 #include "./AAStar.hpp"
 #include "./Node.hpp"
+#include "./OccupancyPyramid.hpp"
+#include "./PathCache.hpp"
+#include "./VersionedMap.hpp"
+#include "./GoalTree.hpp"
 #include "../ParticleSystem/BoundingCircle.hpp"
+#include "../ParticleSystem/TunnelTables.hpp"
+#include "./PathFollower.hpp"
+#include "./SphereBlockOffset.hpp"
+
+class CFlowField;
+class CPathWorker;
 
 #define RADIALSTEP 0.5f
+// number of finished searches CPathFinder::search keeps around
+#define PATHCACHESIZE 32
+// side-length (in nodes) of the cells that bucket multiple goals
+#define GOALCELLSIZE 8
+// initial size (in bytes) of the arena the goal index lives in
+#define QUERY_ARENA_SIZE 4096
+
+// HEURISTIC_EUCLIDEAN: straight-line distance (table lookup)
+// HEURISTIC_GRID: exact shortest-path length on an obstacle-free
+// grid with the current connectivity (Manhattan for 6, 3D octile
+// for 18 and 26)
+enum heuristicType {HEURISTIC_EUCLIDEAN, HEURISTIC_GRID};
+
+// restricts which nodes successors() may generate; a
+// constrained search that fails is retried without it
+enum constraintType {CONSTRAINT_NONE, CONSTRAINT_REGION, CONSTRAINT_CORRIDOR};
+
 
+struct CPathResult;
 
 class CPathFinder: public AAStar {
 	private:
-		void successors(ANode* an, std::queue<ANode*>& succ);
+		void successors(ANode* an, NodeList& succ);
 		float heuristic(ANode* an1, ANode* an2);
-		bool PathCanPass(Node* n);
+		bool isGoal(ANode* an);
+		float goalHeuristic(ANode* an);
+		float distance(int dx, int dy, int dz) const;
 		void GenerateSphereBlockOffsets();
+		void GenerateDistanceTable();
+		void BuildGoalIndex();
+		bool BuildCoarseCorridor();
+		void BeginCorridor();
+		void StampCorridorBox(int x0, int y0, int z0, int x1, int y1, int z1);
 		void BuildPathCurve(float);
 		void BuildTunnel();
-		inline int id(int x, int y, int z) const { return ((x * Y * Z) + (y * Z) + z); }
+		// brings the versioned map, the pyramid, the flow field
+		// and the path cache in line with a node whose blocked
+		// state just changed (by toggleBlocked, or by making a
+		// blocked node the start or a goal)
+		void BlockChanged(int x, int y, int z);
+		void RestoreResult(const std::vector<ANode*>&, const std::vector<vec4>&, const std::vector<BoundingCircle>&);
 
 		float minRad, maxRad, radialScalar;
 
+		// sqrt(i) for every squared integer length i that
+		// two nodes within the world's bounds can produce
+		std::vector<float> sqrtTable;
+
+		int connectivity;
+		heuristicType hType;
+
+		// goals that share a GOALCELLSIZE^3 cell, with the
+		// tight bounds of those goals (for lower-bound culls)
+		struct GoalBucket {
+			GoalBucket(std::pmr::memory_resource* r): goals(r) {}
+
+			int minX, minY, minZ;
+			int maxX, maxY, maxZ;
+			std::pmr::vector<Node*> goals;
+		};
+
+		// backs the goal index, rewound by every BuildGoalIndex
+		CMonotonicArena queryArena;
+		std::pmr::vector<GoalBucket> goalBuckets;
+
+		// search-space constraint; the bounds always hold (for
+		// CONSTRAINT_CORRIDOR they enclose the corridor) and a
+		// corridor node is one whose stamp equals corridorStamp
+		constraintType cType;
+		int cMinX, cMinY, cMinZ;
+		int cMaxX, cMaxY, cMaxZ;
+		unsigned int corridorStamp;
+		std::vector<unsigned int> corridorStamps;
+
+		// blocked-state as PathCanPass sees it, kept in sync with
+		// <map> by toggleBlocked and Reset; search() pins the
+		// current version so edits made meanwhile (from another
+		// thread) can neither stall nor tear it
+		CVersionedMap* versionedMap;
+		const CMapSnapshot* pinnedSnapshot;
+		int pinnedSlot;
+		bool ownsVersionedMap;
+
+		PathFollower pathFollower;
+
+		// coarse-to-fine: a search on a coarse pyramid level
+		// restricts the full-resolution one to a narrow band
+		//
+		// an instance on a shared map sees none of the edits,
+		// so its pyramid is rebuilt whenever the snapshot it
+		// searches is not the one the pyramid was built from
+		COccupancyPyramid* pyramid;
+		CFlowField* flowField;
+		CPathWorker* pathWorker;
+		CPyramidSearch* coarseSearch;
+		unsigned int pyramidVersion;
+		bool coarseToFine;
+
+		// finished searches, keyed on the current mapVersion; it is
+		// bumped by anything that changes every result at once
+		// (Reset, connectivity, heuristic) while toggleBlocked only
+		// drops the entries near the edit
+		CPathCache* pathCache;
+		unsigned int mapVersion;
+		bool usePathCache;
+
+		// backward tree from the (single) goal, reused by every
+		// unconstrained search towards it instead of a forward
+		// search from scratch
+		CGoalTree* goalTree;
+		bool useGoalTree;
+
+		inline bool InSearchSpace(int x, int y, int z) const {
+			if (cType == CONSTRAINT_NONE)
+				return true;
+			if (x < cMinX || x > cMaxX || y < cMinY || y > cMaxY || z < cMinZ || z > cMaxZ)
+				return false;
+
+			return (cType == CONSTRAINT_REGION || corridorStamps[id(x, y, z)] == corridorStamp);
+		}
+
 	public:
-		CPathFinder(int X, int Y, int Z);
+		// pins the current snapshot for as long as it lives (also
+		// when a search task is destroyed before it finishes); a
+		// search run on the pathfinder's behalf from other threads
+		// (eg. CParallelSearch) holds one as well
+		struct SnapshotPin {
+			SnapshotPin(CPathFinder* p): pf(p) { pf->pinnedSnapshot = pf->versionedMap->Pin(pf->pinnedSlot); }
+			~SnapshotPin() { pf->versionedMap->Unpin(pf->pinnedSlot); pf->pinnedSnapshot = 0x0; }
+
+			CPathFinder* pf;
+		};
+
+		// an instance given <sharedMap> (eg. the one searching on
+		// a CPathWorker's thread) reads its obstacles from there
+		// and never edits them itself
+		CPathFinder(int X, int Y, int Z, CVersionedMap* sharedMap = 0x0);
+		~CPathFinder();
 		void setStart(int x, int y, int z);
 		void setGoal(int x, int y, int z);
+		void addGoal(int x, int y, int z);
+		void clearGoals();
 		void toggleBlocked(int x, int y, int z);
+		// the field toggleBlocked repairs along with the pyramid
+		// (set by CFlowField itself)
+		void SetFlowField(CFlowField* ff) { flowField = ff; }
+		CFlowField* GetFlowField() const { return flowField; }
+		// the worker searching for this instance (set by
+		// CPathWorker itself)
+		void SetPathWorker(CPathWorker* pw) { pathWorker = pw; }
 		void toggleShowBlockedNodes() { showBlockedNodes = !showBlockedNodes; }
 		void toggleShowVisitedNodes() { showVisitedNodes = !showVisitedNodes; }
 		void toggleShowBackBonePath() { showBackBonePath = !showBackBonePath; }
+		void SetConnectivity(int c) { connectivity = (c == 6 || c == 18)? c: 26; mapVersion++; }
+		void SetHeuristicType(heuristicType t) { hType = t; mapVersion++; }
+		void BenchmarkHeuristic(unsigned int numSamples);
+		void SetSearchRegion(int minX, int minY, int minZ, int maxX, int maxY, int maxZ);
+		void SetSearchCorridor(const std::vector<ANode*>& corridorPath, int width);
+		void ClearSearchConstraint() { cType = CONSTRAINT_NONE; }
+		void SetCoarseToFine(bool b) { coarseToFine = b; }
+		bool GetCoarseToFine() const { return coarseToFine; }
+		// search latency with and without the coarse-to-fine
+		// stage on a <size>^3 map of its own
+		static void BenchmarkCoarseToFine(int size, float minRad, float maxRad, unsigned int numRuns);
+		void SetPathCaching(bool b) { usePathCache = b; }
+		const CPathCache* GetPathCache() const { return pathCache; }
+		void SetGoalTreeReuse(bool b) { useGoalTree = b; }
+		bool GetGoalTreeReuse() const { return useGoalTree; }
+		const CGoalTree* GetGoalTree() const { return goalTree; }
+		CVersionedMap* GetVersionedMap() const { return versionedMap; }
+		unsigned int GetMapVersion() const { return mapVersion; }
+		// swaps in a path computed in the background; false if
+		// the map was reset or edited or the start moved since
+		// the request
+		bool ApplyResult(const CPathResult& r);
 		void Reset();
 		void search(float minRad, float maxRad);
+		// search() as a task that suspends whenever <budget> runs
+		// out; search() itself just runs one to completion
+		SearchTask searchTask(float minRad, float maxRad, SearchBudget budget);
+		void BenchmarkSuspension(float minRad, float maxRad, unsigned int numRuns);
+		// counts the heap allocations of <numRuns> uncached
+		// searches (none once the arenas stopped growing); waits
+		// for the path worker, whose allocations would count too
+		void ProbeAllocations(float minRad, float maxRad, unsigned int numRuns);
 		void update();
 		vec3 GetWorldSize() const { return vec3(X, Y, Z); }
 
-		struct SphereBlockOffset {
-			SphereBlockOffset(float _r = 0.0f, int _x = 0, int _y = 0, int _z = 0) {
-				r = _r; x = _x; y = _y; z = _z;
-			}
-
-			bool operator () (const SphereBlockOffset& obs) const {
-				return (x == obs.x && y == obs.y && z == obs.z);
-			}
+		// clearance and cost logic shared with the searches run
+		// at the pathfinder's own radii (eg. CGoalTree); those
+		// must be set by SetSearchRadii before PathCanPass is valid
+		void SetSearchRadii(float minRad, float maxRad);
+		bool PathCanPass(Node* n);
+		// fills <nbrs> (room for 26) with the in-bounds neighbours
+		// of <n> the connectivity and search-space constraint allow
+		// and returns their number; reads nothing but the map layout
+		int GetNeighbours(const Node* n, Node** nbrs);
+		float Distance(const Node* n1, const Node* n2) const { return distance(n1->x - n2->x, n1->y - n2->y, n1->z - n2->z); }
+		float NodeWeight(const Node* n) const { return (NodeWeight(n->radius, maxRad)); }
+		float NodeWeight(float radius, float maxRad) const { return (radialScalar * ((1.0f - radius / maxRad) + 1.0f)); }
+		// lower bound on NodeWeight (no radius exceeds maxRad)
+		float MinNodeWeight() const { return radialScalar; }
+		int GetConnectivity() const { return connectivity; }
+		heuristicType GetHeuristicType() const { return hType; }
+		inline int id(int x, int y, int z) const { return ((x * Y * Z) + (y * Z) + z); }
 
-			float r;
-			int x;
-			int y;
-			int z;
-		};
+		// the clearance test for radii of the caller's own (eg.
+		// CFlowField's, COccupancyPyramid's), which changes none
+		// of the pathfinder's settings nor the node: <offsets>
+		// come from GenerateSphereBlockOffsets(maxRad, ...) and
+		// <*radius> receives the corridor radius at <n>
+		void GenerateSphereBlockOffsets(float maxRad, std::vector<SphereBlockOffset>& offsets) const;
+		bool PathCanPass(const Node* n, float minRad, float maxRad, const std::vector<SphereBlockOffset>& offsets, float* radius) const;
 
 		std::vector<SphereBlockOffset> sphereBlockOffsets;
 		std::vector<Node> map;
 		std::vector<Node*> blocked;
+		std::vector<Node*> goals;
 		std::vector<ANode*> path;
 		std::vector<vec4> curve;
 		std::vector<BoundingCircle> tunnel;
+		// rebuilt with <tunnel> (by BuildTunnel and RestoreResult)
+		TunnelTables tunnelTables;
 
 		int X, Y, Z;
 		int sId, gId;
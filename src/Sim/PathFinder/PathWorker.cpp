@@ -0,0 +1,178 @@
+#include <chrono>
+
+#include "./PathWorker.hpp"
+#include "./PathFinder.hpp"
+
+#define NODE(n) static_cast<Node*>(n)
+
+bool CPathWorker::RequestQueue::Push(const PathRequest& r) {
+	const unsigned int t = tail.load(std::memory_order_relaxed);
+
+	if ((t - head.load(std::memory_order_acquire)) == PATHWORKER_QUEUE_SIZE)
+		return false;
+
+	ring[t & (PATHWORKER_QUEUE_SIZE - 1)] = r;
+	tail.store(t + 1, std::memory_order_release);
+	return true;
+}
+
+bool CPathWorker::RequestQueue::Pop(PathRequest& r) {
+	const unsigned int h = head.load(std::memory_order_relaxed);
+
+	if (h == tail.load(std::memory_order_acquire))
+		return false;
+
+	r = ring[h & (PATHWORKER_QUEUE_SIZE - 1)];
+	head.store(h + 1, std::memory_order_release);
+	return true;
+}
+
+
+
+CPathWorker::CPathWorker(CPathFinder* pf) {
+	const vec3 size = pf->GetWorldSize();
+
+	this->pf = pf;
+	this->searcher = new CPathFinder(int(size.x), int(size.y), int(size.z), pf->GetVersionedMap());
+	// <searcher> never sees the edits that invalidate entries
+	this->searcher->SetPathCaching(false);
+
+	numRequests = 0;
+
+	result.store(0x0);
+	busy.store(false);
+	quit.store(false);
+
+	thread = std::thread(&CPathWorker::Run, this);
+
+	pf->SetPathWorker(this);
+}
+
+CPathWorker::~CPathWorker() {
+	pf->SetPathWorker(0x0);
+
+	quit.store(true);
+	thread.join();
+
+	delete result.exchange(0x0);
+	delete searcher; searcher = 0x0;
+}
+
+bool CPathWorker::Submit(float minRad, float maxRad) {
+	PathRequest r;
+	r.requestId = ++numRequests;
+	r.mapVersion = pf->GetMapVersion();
+	r.snapshotVersion = pf->GetVersionedMap()->GetCurrent()->GetVersion();
+	r.sId = pf->sId;
+	r.minRad = minRad;
+	r.maxRad = maxRad;
+	r.connectivity = pf->GetConnectivity();
+	r.hType = pf->GetHeuristicType();
+	r.reuseGoalTree = pf->GetGoalTreeReuse();
+	r.coarseToFine = pf->GetCoarseToFine();
+	r.recordTrace = pf->trace.IsOn();
+
+	for (unsigned int i = 0; i < pf->goals.size(); i++) {
+		r.gIds.push_back(pf->goals[i]->id);
+	}
+
+	return requests.Push(r);
+}
+
+void CPathWorker::WaitIdle() const {
+	while (!requests.Empty() || busy.load()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+
+void CPathWorker::Run() {
+	PathRequest r;
+
+	while (!quit.load()) {
+		bool haveRequest = false;
+
+		// set before popping so WaitIdle never sees an empty
+		// queue and an idle worker while a request is in hand
+		busy.store(true);
+
+		// newer requests supersede the ones queued before them
+		while (requests.Pop(r)) {
+			haveRequest = true;
+		}
+
+		if (!haveRequest) {
+			busy.store(false);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		CPathResult* res = Search(r);
+
+		// drop the previous result if nobody took it
+		if (res != 0x0) {
+			delete result.exchange(res);
+		}
+
+		busy.store(false);
+	}
+}
+
+CPathResult* CPathWorker::Search(const PathRequest& r) {
+	const Node& s = searcher->map[r.sId];
+
+	// both invalidate the searcher's goal tree, even if unchanged
+	if (r.connectivity != searcher->GetConnectivity())
+		searcher->SetConnectivity(r.connectivity);
+	if (r.hType != searcher->GetHeuristicType())
+		searcher->SetHeuristicType(heuristicType(r.hType));
+
+	searcher->SetGoalTreeReuse(r.reuseGoalTree);
+	searcher->SetCoarseToFine(r.coarseToFine);
+
+	// the records are replayed into pf's own trace (ring or file)
+	if (r.recordTrace != searcher->trace.IsOn())
+		searcher->trace.SetMode(r.recordTrace? TRACE_RING: TRACE_OFF);
+	searcher->setStart(s.x, s.y, s.z);
+	searcher->clearGoals();
+
+	for (unsigned int i = 0; i < r.gIds.size(); i++) {
+		const Node& g = searcher->map[r.gIds[i]];
+		searcher->addGoal(g.x, g.y, g.z);
+	}
+
+	searcher->path.clear();
+	searcher->curve.clear();
+	searcher->tunnel.clear();
+	searcher->tunnelTables.Clear();
+	searcher->canSearch = true;
+
+	{
+		SearchTask t = searcher->searchTask(r.minRad, r.maxRad, SearchBudget(0, PATHWORKER_SLICE_TIME));
+
+		while (t.Resume()) {
+			if (quit.load() || !requests.Empty())
+				return 0x0;
+		}
+	}
+
+	CPathResult* res = new CPathResult();
+	res->requestId = r.requestId;
+	res->mapVersion = r.mapVersion;
+	res->snapshotVersion = r.snapshotVersion;
+	res->sId = r.sId;
+	res->gId = searcher->gId;
+	res->curve = searcher->curve;
+	res->tunnel = searcher->tunnel;
+
+	// the nodes of both maps share their ids
+	res->path.reserve(searcher->path.size());
+
+	for (unsigned int i = 0; i < searcher->path.size(); i++) {
+		res->path.push_back(&pf->map[NODE(searcher->path[i])->id]);
+	}
+
+	searcher->trace.CopyTo(res->trace);
+
+	return res;
+}
@@ -0,0 +1,113 @@
+#ifndef PATHWORKER_HPP
+#define PATHWORKER_HPP
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "../../Math/vec3.hpp"
+#include "../ParticleSystem/BoundingCircle.hpp"
+#include "./SearchTrace.hpp"
+
+// capacity (power of two) of the request queue
+#define PATHWORKER_QUEUE_SIZE 16
+// how long (usecs) the worker searches before it checks
+// whether a newer request superseded the current one
+#define PATHWORKER_SLICE_TIME 2000
+
+class ANode;
+class CPathFinder;
+
+struct PathRequest {
+	unsigned int requestId;
+	unsigned int mapVersion;
+	// version of the obstacle snapshot when the request was made
+	unsigned int snapshotVersion;
+
+	int sId;
+	std::vector<int> gIds;
+	float minRad;
+	float maxRad;
+	int connectivity;
+	int hType;
+	bool reuseGoalTree;
+	bool coarseToFine;
+	bool recordTrace;
+};
+
+// everything CPathFinder::search produces, with all node
+// pointers into the requesting CPathFinder's map; never
+// modified after the worker publishes it
+struct CPathResult {
+	unsigned int requestId;
+	unsigned int mapVersion;
+	unsigned int snapshotVersion;
+
+	int sId;
+	int gId;
+
+	std::vector<ANode*> path;
+	std::vector<vec4> curve;
+	std::vector<BoundingCircle> tunnel;
+	std::vector<TraceRecord> trace;
+};
+
+// runs searches for <pf> on a thread of its own: requests go
+// in through a lock-free single-producer queue (the thread
+// that owns <pf> is the only producer) and the last finished
+// result is handed over with a single atomic exchange; a
+// search superseded by a newer request while it runs is
+// abandoned at its next suspension point
+//
+// the worker searches a private CPathFinder that reads its
+// obstacles from <pf>'s versioned map, so edits of <pf> can
+// go on in the meantime; it does not use <pf>'s path cache or
+// search-space constraints (but does keep a goal tree and an
+// occupancy pyramid of its own if <pf> uses them)
+class CPathWorker {
+	public:
+		CPathWorker(CPathFinder* pf);
+		~CPathWorker();
+
+		// queues a search from pf's start to its goal(s) with
+		// pf's current connectivity and heuristic; only the most
+		// recent request still queued when the worker gets to it
+		// is run, the others are superseded
+		bool Submit(float minRad, float maxRad);
+		// returns the newest finished result (to be deleted by
+		// the caller) or 0x0 if nothing finished since last time
+		const CPathResult* TakeResult() { return result.exchange(0x0); }
+		bool IsBusy() const { return busy.load(); }
+		// blocks until every queued request has been run or
+		// superseded (only from the thread that submits)
+		void WaitIdle() const;
+
+	private:
+		struct RequestQueue {
+			RequestQueue(): head(0), tail(0) {}
+
+			bool Push(const PathRequest& r);
+			bool Pop(PathRequest& r);
+			bool Empty() const { return (head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire)); }
+
+			alignas(64) std::atomic<unsigned int> head;
+			alignas(64) std::atomic<unsigned int> tail;
+			PathRequest ring[PATHWORKER_QUEUE_SIZE];
+		};
+
+		void Run();
+		CPathResult* Search(const PathRequest& r);
+
+		CPathFinder* pf;
+		CPathFinder* searcher;
+
+		RequestQueue requests;
+		unsigned int numRequests;
+
+		std::atomic<const CPathResult*> result;
+		std::atomic<bool> busy;
+		std::atomic<bool> quit;
+		std::thread thread;
+};
+
+#endif
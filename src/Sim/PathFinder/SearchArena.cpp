@@ -0,0 +1,42 @@
+#include <new>
+#include <algorithm>
+
+#include "./SearchArena.hpp"
+
+void* CSearchArena::AllocateFrame(std::size_t size) {
+	const std::size_t total = (FRAME_HEADER + size + (FRAME_HEADER - 1)) & ~(FRAME_HEADER - 1);
+
+	char* mem = 0x0;
+	CSearchArena* owner = 0x0;
+
+	if ((offset + total) <= buffer.size()) {
+		mem = &buffer[offset];
+		owner = this;
+
+		offset += total;
+		peakOffset = std::max(peakOffset, offset);
+		numLive += 1;
+	} else {
+		mem = static_cast<char*>(::operator new(total));
+		numHeapFrames += 1;
+	}
+
+	*reinterpret_cast<CSearchArena**>(mem) = owner;
+	return (mem + FRAME_HEADER);
+}
+
+void CSearchArena::FreeFrame(void* p) {
+	char* mem = static_cast<char*>(p) - FRAME_HEADER;
+	CSearchArena* owner = *reinterpret_cast<CSearchArena**>(mem);
+
+	if (owner == 0x0) {
+		::operator delete(mem);
+		return;
+	}
+
+	// frames are not freed in order, so the space is
+	// only reused once all of them are gone again
+	if ((owner->numLive -= 1) == 0) {
+		owner->offset = 0;
+	}
+}
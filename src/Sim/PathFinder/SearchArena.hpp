@@ -0,0 +1,35 @@
+#ifndef SEARCHARENA_HPP
+#define SEARCHARENA_HPP
+
+#include <vector>
+#include <cstddef>
+
+// bump allocator for the coroutine frames of a searcher's
+// tasks: frames are carved out of one fixed buffer that is
+// rewound as soon as no frame is alive anymore, so running a
+// search as a task costs no heap allocation (one that does
+// not fit goes to the heap instead, and is counted)
+class CSearchArena {
+	public:
+		CSearchArena(unsigned int size): buffer(size), offset(0), peakOffset(0), numLive(0), numHeapFrames(0) {}
+
+		void* AllocateFrame(std::size_t size);
+		static void FreeFrame(void* p);
+
+		unsigned int GetNumHeapFrames() const { return numHeapFrames; }
+		unsigned int GetPeakUsage() const { return peakOffset; }
+
+	private:
+		// each frame is preceded by the arena it came from (0x0
+		// for heap frames), padded to keep the frame aligned
+		static const std::size_t FRAME_HEADER = 16;
+
+		std::vector<char> buffer;
+		std::size_t offset;
+		std::size_t peakOffset;
+
+		unsigned int numLive;
+		unsigned int numHeapFrames;
+};
+
+#endif
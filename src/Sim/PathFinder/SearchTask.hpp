@@ -0,0 +1,101 @@
+#ifndef SEARCHTASK_HPP
+#define SEARCHTASK_HPP
+
+#include <coroutine>
+#include <exception>
+#include <chrono>
+
+#include "./SearchArena.hpp"
+
+// how much work a search task may do before it suspends
+// (0 means no limit, both 0 runs the task to completion)
+struct SearchBudget {
+	SearchBudget(unsigned int n = 0, unsigned int us = 0): maxExpansions(n), maxMicros(us) {}
+
+	unsigned int maxExpansions;
+	unsigned int maxMicros;
+};
+
+// tracks one slice of a budget inside a search task
+class SearchSlice {
+	public:
+		SearchSlice(const SearchBudget& b): budget(b) { Begin(0); }
+
+		void Begin(unsigned int numExpanded) {
+			startExpanded = numExpanded;
+			numChecks = 0;
+
+			if (budget.maxMicros != 0) {
+				startTime = std::chrono::steady_clock::now();
+			}
+		}
+
+		bool Expired(unsigned int numExpanded) {
+			if (budget.maxExpansions != 0 && (numExpanded - startExpanded) >= budget.maxExpansions)
+				return true;
+			// reading the clock costs more than a step does
+			if (budget.maxMicros == 0 || ((++numChecks) & 63) != 0)
+				return false;
+
+			const std::chrono::steady_clock::duration dt = std::chrono::steady_clock::now() - startTime;
+			return (std::chrono::duration_cast<std::chrono::microseconds>(dt).count() >= budget.maxMicros);
+		}
+
+	private:
+		SearchBudget budget;
+
+		unsigned int startExpanded;
+		unsigned int numChecks;
+		std::chrono::steady_clock::time_point startTime;
+};
+
+// a search suspended at its last co_yield; the owner
+// resumes it inline, from the sim loop once per frame
+// or from any other thread (one at a time)
+class SearchTask {
+	public:
+		struct promise_type {
+			promise_type(): result(false), numSuspensions(0) {}
+
+			SearchTask get_return_object() { return SearchTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+			std::suspend_always initial_suspend() noexcept { return std::suspend_always(); }
+			std::suspend_always final_suspend() noexcept { return std::suspend_always(); }
+			std::suspend_always yield_value(unsigned int) noexcept { numSuspensions++; return std::suspend_always(); }
+			void return_value(bool b) { result = b; }
+			void unhandled_exception() { std::terminate(); }
+
+			// the frame of a coroutine member of <owner> comes
+			// from the owner's arena (see AAStar::GetFrameArena)
+			template<typename Owner, typename... Args>
+			static void* operator new(std::size_t size, Owner& owner, Args&...) { return owner.GetFrameArena()->AllocateFrame(size); }
+			static void operator delete(void* p) { CSearchArena::FreeFrame(p); }
+
+			bool result;
+			unsigned int numSuspensions;
+		};
+
+		SearchTask(SearchTask&& t): handle(t.handle) { t.handle = 0x0; }
+		~SearchTask() { if (handle) handle.destroy(); }
+
+		// runs the task up to its next suspension point, returns
+		// false once it has finished (GetResult is valid then)
+		bool Resume() {
+			if (!handle.done())
+				handle.resume();
+
+			return !handle.done();
+		}
+
+		bool IsDone() const { return handle.done(); }
+		bool GetResult() const { return handle.promise().result; }
+		unsigned int GetNumSuspensions() const { return handle.promise().numSuspensions; }
+
+	private:
+		SearchTask(std::coroutine_handle<promise_type> h): handle(h) {}
+		SearchTask(const SearchTask&);
+		SearchTask& operator = (const SearchTask&);
+
+		std::coroutine_handle<promise_type> handle;
+};
+
+#endif
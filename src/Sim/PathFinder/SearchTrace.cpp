@@ -0,0 +1,60 @@
+#include "./SearchTrace.hpp"
+
+bool CSearchTrace::SetMode(traceMode m, const char* fileName) {
+	FILE* f = 0x0;
+
+	if (m == TRACE_FILE) {
+		if (fileName == 0x0 || (f = fopen(fileName, "wb")) == 0x0)
+			return false;
+
+		fwrite("ASTRACE1", 8, 1, f);
+	}
+
+	if (file != 0x0) {
+		fclose(file);
+	}
+
+	mode = m;
+	file = f;
+	head = 0;
+	numSearches = 0;
+
+	// the ring only takes memory while it is in use
+	if (mode == TRACE_RING) {
+		ring.resize(SEARCHTRACESIZE);
+	} else {
+		std::vector<TraceRecord>().swap(ring);
+	}
+
+	return true;
+}
+
+void CSearchTrace::Begin() {
+	head = 0;
+
+	if (mode == TRACE_FILE) {
+		Record(numSearches, TRACE_SEARCH_BEGIN);
+	}
+
+	numSearches += 1;
+}
+
+void CSearchTrace::CopyTo(std::vector<TraceRecord>& records) const {
+	records.clear();
+	records.reserve(GetNumRecords());
+
+	for (unsigned int i = 0; i < GetNumRecords(); i++) {
+		records.push_back(GetRecord(i));
+	}
+}
+
+void CSearchTrace::Replay(const std::vector<TraceRecord>& records) {
+	Begin();
+
+	if (mode == TRACE_OFF)
+		return;
+
+	for (unsigned int i = 0; i < records.size(); i++) {
+		Record(records[i].node, records[i].parent);
+	}
+}
@@ -0,0 +1,88 @@
+#ifndef SEARCHTRACE_HPP
+#define SEARCHTRACE_HPP
+
+#include <vector>
+#include <cstdio>
+
+// builds with -DSEARCH_TRACE=0 compile every recording call
+// out of the search loop (whatever the runtime mode)
+#ifndef SEARCH_TRACE
+#define SEARCH_TRACE 1
+#endif
+
+// capacity (power of two, in records) of the trace ring
+#define SEARCHTRACESIZE (1 << 18)
+
+// <parent> values that mark a record as something other
+// than an opened node
+#define TRACE_SEARCH_BEGIN 0xFFFFFFFFu
+#define TRACE_PATH_NODE    0xFFFFFFFEu
+
+// TRACE_OFF: nothing is written
+// TRACE_RING: the newest SEARCHTRACESIZE records of the last
+// search are kept in memory (what CPathFinderDrawer shows)
+// TRACE_FILE: the records of every search are streamed to
+// a binary file for offline replay
+enum traceMode {TRACE_OFF, TRACE_RING, TRACE_FILE};
+
+// a node opened from <parent>, a node on the final path
+// (in AAStar::tracePath order) or the start of search #node
+struct TraceRecord {
+	unsigned int node;
+	unsigned int parent;
+
+	bool IsPathNode() const { return (parent == TRACE_PATH_NODE); }
+};
+
+// what a search records for visualization: the file is a
+// "ASTRACE1" tag followed by raw TraceRecords, every search
+// beginning with a TRACE_SEARCH_BEGIN record
+class CSearchTrace {
+	public:
+		CSearchTrace(): mode(TRACE_OFF), head(0), numSearches(0), file(0x0) {}
+		~CSearchTrace() { SetMode(TRACE_OFF); }
+
+		// returns false if the file could not be opened (in
+		// which case the mode does not change)
+		bool SetMode(traceMode m, const char* fileName = 0x0);
+		traceMode GetMode() const { return mode; }
+		bool IsOn() const { return (mode != TRACE_OFF); }
+
+		// called when a search starts (the ring is cleared)
+		void Begin();
+		void RecordOpen(unsigned int node, unsigned int parent) { Record(node, parent); }
+		void RecordPath(unsigned int node) { Record(node, TRACE_PATH_NODE); }
+
+		// records of the last search still in the ring, oldest
+		// first (always 0 in the other modes)
+		unsigned int GetNumRecords() const { return ((head < ring.size())? head: ring.size()); }
+		const TraceRecord& GetRecord(unsigned int i) const { return ring[(head - GetNumRecords() + i) & (SEARCHTRACESIZE - 1)]; }
+		// records overwritten in the ring during the last search
+		unsigned int GetNumDropped() const { return (head - GetNumRecords()); }
+
+		// the ring's records, and a search made of <records>
+		// (eg. by another CSearchTrace) replayed into this one
+		void CopyTo(std::vector<TraceRecord>& records) const;
+		void Replay(const std::vector<TraceRecord>& records);
+
+	private:
+		void Record(unsigned int node, unsigned int parent) {
+			const TraceRecord r = {node, parent};
+
+			if (mode == TRACE_RING) {
+				ring[(head++) & (SEARCHTRACESIZE - 1)] = r;
+			} else {
+				fwrite(&r, sizeof(TraceRecord), 1, file);
+			}
+		}
+
+		traceMode mode;
+
+		std::vector<TraceRecord> ring;
+		unsigned int head;
+
+		unsigned int numSearches;
+		FILE* file;
+};
+
+#endif
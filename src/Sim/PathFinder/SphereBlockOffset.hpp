@@ -0,0 +1,21 @@
+#ifndef SPHEREBLOCKOFFSET_HPP
+#define SPHEREBLOCKOFFSET_HPP
+
+// XYZ-offset of a node within the block-sphere of radius <r>
+// around a node the clearance test inflates its balloon at
+struct SphereBlockOffset {
+	SphereBlockOffset(float _r = 0.0f, int _x = 0, int _y = 0, int _z = 0) {
+		r = _r; x = _x; y = _y; z = _z;
+	}
+
+	bool operator () (const SphereBlockOffset& obs) const {
+		return (x == obs.x && y == obs.y && z == obs.z);
+	}
+
+	float r;
+	int x;
+	int y;
+	int z;
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include <thread>
+#include <algorithm>
+
+#include "./VersionedMap.hpp"
+#include "./Node.hpp"
+
+void MapChunk::SetBlocked(int x, int y, int z, bool blocked) {
+	const int b = GetBit(x, y, z);
+	const unsigned long long m = (1ULL << (b & 63));
+
+	if (((bits[b >> 6] & m) != 0) == blocked)
+		return;
+
+	if (blocked) {
+		bits[b >> 6] |= m;
+		subCounts[GetSubBlock(x, y, z)] += 1;
+		count += 1;
+	} else {
+		bits[b >> 6] &= ~m;
+		subCounts[GetSubBlock(x, y, z)] -= 1;
+		count -= 1;
+	}
+}
+
+
+
+bool CMapSnapshot::IsRegionEmpty(int x0, int y0, int z0, int x1, int y1, int z1) const {
+	// visit the chunks overlapping the region and
+	// descend into the sub-blocks only where necessary
+	for (int cx = (x0 >> CHUNKSHIFT); cx <= (x1 >> CHUNKSHIFT); cx++) {
+		for (int cy = (y0 >> CHUNKSHIFT); cy <= (y1 >> CHUNKSHIFT); cy++) {
+			for (int cz = (z0 >> CHUNKSHIFT); cz <= (z1 >> CHUNKSHIFT); cz++) {
+				const MapChunk* c = chunks[((cx * chunksY) + cy) * chunksZ + cz];
+
+				if (c->count == 0)
+					continue;
+
+				const int sx0 = std::max(x0, cx << CHUNKSHIFT), sx1 = std::min(x1, ((cx + 1) << CHUNKSHIFT) - 1);
+				const int sy0 = std::max(y0, cy << CHUNKSHIFT), sy1 = std::min(y1, ((cy + 1) << CHUNKSHIFT) - 1);
+				const int sz0 = std::max(z0, cz << CHUNKSHIFT), sz1 = std::min(z1, ((cz + 1) << CHUNKSHIFT) - 1);
+
+				for (int sx = (sx0 >> SUBBLOCKSHIFT); sx <= (sx1 >> SUBBLOCKSHIFT); sx++) {
+					for (int sy = (sy0 >> SUBBLOCKSHIFT); sy <= (sy1 >> SUBBLOCKSHIFT); sy++) {
+						for (int sz = (sz0 >> SUBBLOCKSHIFT); sz <= (sz1 >> SUBBLOCKSHIFT); sz++) {
+							if (c->subCounts[MapChunk::GetSubBlock(sx << SUBBLOCKSHIFT, sy << SUBBLOCKSHIFT, sz << SUBBLOCKSHIFT)] != 0)
+								return false;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+
+
+CVersionedMap::CVersionedMap(int X, int Y, int Z) {
+	this->X = X;
+	this->Y = Y;
+	this->Z = Z;
+
+	CMapSnapshot* s = new CMapSnapshot();
+	s->chunksX = ((X - 1) >> CHUNKSHIFT) + 1;
+	s->chunksY = ((Y - 1) >> CHUNKSHIFT) + 1;
+	s->chunksZ = ((Z - 1) >> CHUNKSHIFT) + 1;
+	s->version = 0;
+	s->chunks.resize(s->chunksX * s->chunksY * s->chunksZ, &emptyChunk);
+
+	current.store(s);
+	// 0 marks a free reader slot
+	epoch.store(1);
+
+	for (int i = 0; i < MAPMAXREADERS; i++) {
+		readerEpochs[i].store(0);
+	}
+
+	numReclaimed = 0;
+}
+
+CVersionedMap::~CVersionedMap() {
+	const CMapSnapshot* s = current.load();
+
+	// no reader can be left at this point
+	for (unsigned int i = 0; i < s->chunks.size(); i++) {
+		if (s->chunks[i] != &emptyChunk) {
+			delete s->chunks[i];
+		}
+	}
+
+	delete s;
+
+	for (unsigned int i = 0; i < retired.size(); i++) {
+		for (unsigned int j = 0; j < retired[i].chunks.size(); j++) {
+			delete retired[i].chunks[j];
+		}
+
+		delete retired[i].snapshot;
+	}
+}
+
+void CVersionedMap::SetBlocked(int x, int y, int z, bool blocked) {
+	std::lock_guard<std::mutex> lock(writeMutex);
+
+	const CMapSnapshot* cur = current.load();
+	const int ci = cur->GetChunkIdx(x, y, z);
+	const MapChunk* oc = cur->chunks[ci];
+
+	if (oc->IsBlocked(x, y, z) == blocked)
+		return;
+
+	MapChunk* nc = new MapChunk(*oc);
+	nc->SetBlocked(x, y, z, blocked);
+
+	CMapSnapshot* ns = new CMapSnapshot(*cur);
+	ns->version = cur->version + 1;
+	ns->chunks[ci] = nc;
+
+	current.store(ns);
+
+	// only <oc> is no longer referenced by the new version
+	std::vector<const MapChunk*> oldChunks;
+
+	if (oc != &emptyChunk) {
+		oldChunks.push_back(oc);
+	}
+
+	Retire(cur, oldChunks);
+}
+
+void CVersionedMap::Rebuild(const std::vector<Node>& map) {
+	std::lock_guard<std::mutex> lock(writeMutex);
+
+	const CMapSnapshot* cur = current.load();
+	CMapSnapshot* ns = new CMapSnapshot(*cur);
+	std::vector<MapChunk*> chunks(cur->chunks.size(), 0x0);
+
+	for (unsigned int i = 0; i < map.size(); i++) {
+		const Node& n = map[i];
+
+		if (n.bType != BLOCKED)
+			continue;
+
+		MapChunk*& c = chunks[cur->GetChunkIdx(n.x, n.y, n.z)];
+
+		if (c == 0x0) {
+			c = new MapChunk();
+		}
+
+		c->SetBlocked(n.x, n.y, n.z, true);
+	}
+
+	ns->version = cur->version + 1;
+
+	for (unsigned int i = 0; i < chunks.size(); i++) {
+		ns->chunks[i] = (chunks[i] != 0x0)? chunks[i]: &emptyChunk;
+	}
+
+	current.store(ns);
+
+	std::vector<const MapChunk*> oldChunks;
+
+	for (unsigned int i = 0; i < cur->chunks.size(); i++) {
+		if (cur->chunks[i] != &emptyChunk) {
+			oldChunks.push_back(cur->chunks[i]);
+		}
+	}
+
+	Retire(cur, oldChunks);
+}
+
+const CMapSnapshot* CVersionedMap::Pin(int& slot) {
+	while (true) {
+		for (int i = 0; i < MAPMAXREADERS; i++) {
+			unsigned long long e = 0;
+
+			// announce the epoch BEFORE loading the snapshot: anything
+			// unlinked after this point was retired at >= that epoch
+			if (readerEpochs[i].compare_exchange_strong(e, epoch.load())) {
+				slot = i;
+				return current.load();
+			}
+		}
+
+		std::this_thread::yield();
+	}
+
+	return 0x0;
+}
+
+void CVersionedMap::Unpin(int slot) {
+	readerEpochs[slot].store(0);
+}
+
+void CVersionedMap::Retire(const CMapSnapshot* s, const std::vector<const MapChunk*>& chunks) {
+	RetiredVersion rv;
+	rv.snapshot = s;
+	rv.chunks = chunks;
+	rv.epoch = epoch.fetch_add(1);
+
+	retired.push_back(rv);
+	Reclaim();
+}
+
+void CVersionedMap::Reclaim() {
+	unsigned long long minEpoch = epoch.load();
+
+	for (int i = 0; i < MAPMAXREADERS; i++) {
+		const unsigned long long e = readerEpochs[i].load();
+
+		if (e != 0) {
+			minEpoch = std::min(minEpoch, e);
+		}
+	}
+
+	// a reader that announced epoch e can still hold anything
+	// retired at an epoch >= e, everything older is unreachable
+	unsigned int n = 0;
+
+	for (unsigned int i = 0; i < retired.size(); i++) {
+		if (retired[i].epoch >= minEpoch) {
+			retired[n++] = retired[i];
+			continue;
+		}
+
+		for (unsigned int j = 0; j < retired[i].chunks.size(); j++) {
+			delete retired[i].chunks[j];
+		}
+
+		delete retired[i].snapshot;
+		numReclaimed++;
+	}
+
+	retired.resize(n);
+}
@@ -0,0 +1,133 @@
+#ifndef VERSIONEDMAP_HPP
+#define VERSIONEDMAP_HPP
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+#include "../../Common/CommonTypes.hpp"
+
+class Node;
+
+// log2 of the side-lengths of a chunk (16^3 nodes) and of
+// the sub-blocks (4^3 nodes) whose blocked-node counts let
+// IsRegionEmpty skip obstacle-free space in a few lookups
+#define CHUNKSHIFT 4
+#define SUBBLOCKSHIFT 2
+#define CHUNKSIZE (1 << CHUNKSHIFT)
+#define SUBBLOCKSIZE (1 << SUBBLOCKSHIFT)
+#define SUBBLOCKSPERCHUNK (CHUNKSIZE / SUBBLOCKSIZE)
+
+// maximum number of threads that can hold a pinned snapshot
+#define MAPMAXREADERS 32
+
+// blocked-state of the nodes in one chunk; never changed
+// once it is reachable from a published snapshot
+struct MapChunk {
+	MapChunk() {
+		for (int i = 0; i < (CHUNKSIZE * CHUNKSIZE * CHUNKSIZE) / 64; i++) { bits[i] = 0; }
+		for (int i = 0; i < SUBBLOCKSPERCHUNK * SUBBLOCKSPERCHUNK * SUBBLOCKSPERCHUNK; i++) { subCounts[i] = 0; }
+
+		count = 0;
+	}
+
+	static int GetBit(int x, int y, int z) {
+		return (((x & (CHUNKSIZE - 1)) << (CHUNKSHIFT * 2)) | ((y & (CHUNKSIZE - 1)) << CHUNKSHIFT) | (z & (CHUNKSIZE - 1)));
+	}
+	static int GetSubBlock(int x, int y, int z) {
+		const int sx = (x & (CHUNKSIZE - 1)) >> SUBBLOCKSHIFT;
+		const int sy = (y & (CHUNKSIZE - 1)) >> SUBBLOCKSHIFT;
+		const int sz = (z & (CHUNKSIZE - 1)) >> SUBBLOCKSHIFT;
+		return (((sx * SUBBLOCKSPERCHUNK) + sy) * SUBBLOCKSPERCHUNK + sz);
+	}
+
+	bool IsBlocked(int x, int y, int z) const {
+		const int b = GetBit(x, y, z);
+		return (((bits[b >> 6] >> (b & 63)) & 1) != 0);
+	}
+	void SetBlocked(int x, int y, int z, bool blocked);
+
+	unsigned long long bits[(CHUNKSIZE * CHUNKSIZE * CHUNKSIZE) / 64];
+	ubyte subCounts[SUBBLOCKSPERCHUNK * SUBBLOCKSPERCHUNK * SUBBLOCKSPERCHUNK];
+	unsigned short count;
+};
+
+// immutable view of the whole map: consecutive versions
+// share every chunk that was not edited in between
+class CMapSnapshot {
+	public:
+		bool IsBlocked(int x, int y, int z) const {
+			const MapChunk* c = chunks[GetChunkIdx(x, y, z)];
+			return (c->count != 0 && c->subCounts[MapChunk::GetSubBlock(x, y, z)] != 0 && c->IsBlocked(x, y, z));
+		}
+		// bounds are inclusive and must lie inside the map
+		bool IsRegionEmpty(int x0, int y0, int z0, int x1, int y1, int z1) const;
+		unsigned int GetVersion() const { return version; }
+
+	private:
+		friend class CVersionedMap;
+
+		int GetChunkIdx(int x, int y, int z) const {
+			return ((((x >> CHUNKSHIFT) * chunksY) + (y >> CHUNKSHIFT)) * chunksZ + (z >> CHUNKSHIFT));
+		}
+
+		int chunksX, chunksY, chunksZ;
+		unsigned int version;
+
+		std::vector<const MapChunk*> chunks;
+};
+
+// copy-on-write store of the map's blocked-state: editors
+// copy the chunk they change into a new snapshot and publish
+// that atomically, searches pin whichever snapshot is current
+// and never see an edit half-way
+//
+// replaced snapshots and chunks are retired with the epoch at
+// which they were unlinked and freed once every pinned reader
+// has announced a later epoch (epoch-based reclamation)
+class CVersionedMap {
+	public:
+		CVersionedMap(int X, int Y, int Z);
+		~CVersionedMap();
+
+		// writer side (edits are serialized internally)
+		void SetBlocked(int x, int y, int z, bool blocked);
+		// replaces every chunk after a bulk change of <map>
+		void Rebuild(const std::vector<Node>& map);
+
+		// reader side; <slot> must be handed back to Unpin
+		const CMapSnapshot* Pin(int& slot);
+		void Unpin(int slot);
+
+		// only safe on the thread that makes the edits
+		const CMapSnapshot* GetCurrent() const { return current.load(std::memory_order_relaxed); }
+
+		unsigned int GetNumRetired() const { return retired.size(); }
+		unsigned int GetNumReclaimed() const { return numReclaimed; }
+
+	private:
+		struct RetiredVersion {
+			const CMapSnapshot* snapshot;
+			std::vector<const MapChunk*> chunks;
+			unsigned long long epoch;
+		};
+
+		void Retire(const CMapSnapshot* s, const std::vector<const MapChunk*>& chunks);
+		void Reclaim();
+
+		int X, Y, Z;
+
+		// shared by every chunk without obstacles
+		MapChunk emptyChunk;
+
+		std::atomic<const CMapSnapshot*> current;
+		std::atomic<unsigned long long> epoch;
+		// epoch announced by each reader (0 if the slot is free)
+		std::atomic<unsigned long long> readerEpochs[MAPMAXREADERS];
+
+		std::mutex writeMutex;
+		std::vector<RetiredVersion> retired;
+		unsigned int numReclaimed;
+};
+
+#endif
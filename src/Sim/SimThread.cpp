@@ -5,6 +5,8 @@
 #include "./SimThread.hpp"
 #include "./ParticleSystem/ParticleSystem.hpp"
 #include "./PathFinder/PathFinder.hpp"
+#include "./PathFinder/FlowField.hpp"
+#include "./PathFinder/PathWorker.hpp"
 
 CSimThread::CSimThread(uint frameRate, uint frameMult) {
 	paused = false;
@@ -26,11 +28,19 @@ CSimThread::CSimThread(uint frameRate, uint frameMult) {
 	FRAMEMULT = frameMult;
 
 	pf = new CPathFinder(25, 25, 25);
+	// keep the last search around for DrawHistory
+	pf->trace.SetMode(TRACE_RING);
 	pf->Reset();
 	ps = new CParticleSystem(32);
+	ff = new CFlowField(pf);
+	// the particle step and the field take turns on its threads
+	ff->SetThreadPool(ps->GetThreadPool());
+	pw = new CPathWorker(pf);
 }
 
 CSimThread::~CSimThread() {
+	delete pw; pw = 0x0;
+	delete ff; ff = 0x0;
 	delete ps; ps = 0x0;
 	delete pf; pf = 0x0;
 }
@@ -46,6 +56,18 @@ void CSimThread::SimFrame(uint* frame, uint* ftime) {
 	(*frame) += 1;
 	(*ftime) = SDL_GetTicks();
 
+	// paths are searched on the worker's thread, picking
+	// one up costs this frame no more than a few copies
+	const CPathResult* r = pw->TakeResult();
+
+	if (r != 0x0) {
+		if (pf->ApplyResult(*r)) {
+			ps->InitParticles(pf);
+		}
+
+		delete r;
+	}
+
 	pf->update();
 	ps->Update(1.0f / (FRAMERATE * FRAMEMULT), pf);
 
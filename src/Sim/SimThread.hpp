@@ -6,6 +6,8 @@
 class CRenderThread;
 class CParticleSystem;
 class CPathFinder;
+class CFlowField;
+class CPathWorker;
 
 class CSimThread {
 	public:
@@ -24,6 +26,8 @@ class CSimThread {
 		// these should not be here
 		CParticleSystem* GetParticleSystem() const { return ps; }
 		CPathFinder* GetPathFinder() const { return pf; }
+		CFlowField* GetFlowField() const { return ff; }
+		CPathWorker* GetPathWorker() const { return pw; }
 	private:
 		bool paused;
 
@@ -46,6 +50,8 @@ class CSimThread {
 		CRenderThread* renderThread;
 		CParticleSystem* ps;
 		CPathFinder* pf;
+		CFlowField* ff;
+		CPathWorker* pw;
 };
 
 #endif
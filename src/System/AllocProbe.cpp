@@ -0,0 +1,57 @@
+#include <new>
+#include <atomic>
+#include <cstdlib>
+
+#include "./AllocProbe.hpp"
+
+// a relaxed increment per allocation, cheap enough to
+// leave in every build
+static std::atomic<unsigned long long> numAllocs(0);
+
+unsigned long long AllocProbe::GetTotal() {
+	return numAllocs.load(std::memory_order_relaxed);
+}
+
+
+
+void* operator new(std::size_t size) {
+	numAllocs.fetch_add(1, std::memory_order_relaxed);
+
+	void* p = malloc((size != 0)? size: 1);
+
+	if (p == 0x0)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+void* operator new[](std::size_t size) {
+	return ::operator new(size);
+}
+
+// over-aligned types and ParticleAllocator come here
+void* operator new(std::size_t size, std::align_val_t align) {
+	numAllocs.fetch_add(1, std::memory_order_relaxed);
+
+	// aligned_alloc wants a multiple of the alignment
+	const std::size_t a = static_cast<std::size_t>(align);
+	void* p = aligned_alloc(a, (((size != 0)? size: 1) + a - 1) & ~(a - 1));
+
+	if (p == 0x0)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+void* operator new[](std::size_t size, std::align_val_t align) {
+	return ::operator new(size, align);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, std::size_t) noexcept { free(p); }
+void operator delete[](void* p, std::size_t) noexcept { free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { free(p); }
@@ -0,0 +1,20 @@
+#ifndef ALLOCPROBE_HPP
+#define ALLOCPROBE_HPP
+
+// counts the calls to the global operator new, aligned or
+// not (replaced in AllocProbe.cpp), made by any thread while
+// it is in scope: the pool threads working for the probed
+// code are counted, so threads doing unrelated work (eg. a
+// CPathWorker) have to be idle
+class AllocProbe {
+	public:
+		AllocProbe(): n0(GetTotal()) {}
+
+		unsigned int GetCount() const { return (GetTotal() - n0); }
+		static unsigned long long GetTotal();
+
+	private:
+		const unsigned long long n0;
+};
+
+#endif
@@ -4,6 +4,9 @@
 #include "../Sim/SimThread.hpp"
 #include "../Sim/ParticleSystem/ParticleSystem.hpp"
 #include "../Sim/PathFinder/PathFinder.hpp"
+#include "../Sim/PathFinder/FlowField.hpp"
+#include "../Sim/PathFinder/ParallelSearch.hpp"
+#include "../Sim/PathFinder/PathWorker.hpp"
 #include "../Renderer/RenderThread.hpp"
 #include "../Renderer/Camera.hpp"
 #include "../Input/InputThread.hpp"
@@ -286,8 +289,73 @@ void CClient::KeyPressed(SDL_Event* e, bool) {
 		simThread->GetPathFinder()->Reset();
 	}
 	if (e->key.keysym.sym == SDLK_s) {
-		simThread->GetPathFinder()->search(1.5f, 3.0f);
-		simThread->GetParticleSystem()->InitParticles(simThread->GetPathFinder());
+		// the sim picks the result up once the worker is done
+		if (simThread->GetPathFinder()->canSearch) {
+			simThread->GetPathWorker()->Submit(1.5f, 3.0f);
+		}
+	}
+	if (e->key.keysym.sym == SDLK_f) {
+		// field towards the current goal, for any number of agents
+		const Node& g = simThread->GetPathFinder()->map[simThread->GetPathFinder()->gId];
+		simThread->GetFlowField()->Generate(g.x, g.y, g.z, 1.5f, 3.0f);
+	}
+	if (e->key.keysym.sym == SDLK_h) {
+		simThread->GetPathFinder()->BenchmarkHeuristic(1 << 24);
+	}
+	if (e->key.keysym.sym == SDLK_x) {
+		// how a single query scales with the number of threads
+		CParallelSearch(simThread->GetPathFinder()).Benchmark(1.5f, 3.0f, 64);
+	}
+	if (e->key.keysym.sym == SDLK_k) {
+		// cost of suspending a search every N expansions
+		simThread->GetPathFinder()->BenchmarkSuspension(1.5f, 3.0f, 20);
+	}
+	if (e->key.keysym.sym == SDLK_u) {
+		simThread->GetPathFinder()->ProbeAllocations(1.5f, 3.0f, 4);
+	}
+	if (e->key.keysym.sym == SDLK_c) {
+		CParticleSystem::BenchmarkCellList(1.0f, 1000000);
+	}
+	if (e->key.keysym.sym == SDLK_n) {
+		CParticleSystem::BenchmarkBarnesHut(20000);
+	}
+	if (e->key.keysym.sym == SDLK_j) {
+		CParticleSystem::BenchmarkPairKernel(4000);
+	}
+	if (e->key.keysym.sym == SDLK_i) {
+		// how a particle step scales with the number of threads
+		CParticleSystem::BenchmarkThreads(simThread->GetPathFinder(), 4000, 20, 64);
+	}
+	if (e->key.keysym.sym == SDLK_z) {
+		// memory traffic of the integration passes alone
+		CParticleSystem::BenchmarkIntegrators(1 << 22, 20);
+	}
+	if (e->key.keysym.sym == SDLK_o) {
+		CPathFinder* pf = simThread->GetPathFinder();
+		pf->SetGoalTreeReuse(!pf->GetGoalTreeReuse());
+
+		printf("goal-tree reuse %s\n", pf->GetGoalTreeReuse()? "enabled": "disabled");
+	}
+	if (e->key.keysym.sym == SDLK_g) {
+		CPathFinder* pf = simThread->GetPathFinder();
+		pf->SetCoarseToFine(!pf->GetCoarseToFine());
+
+		printf("coarse-to-fine search %s\n", pf->GetCoarseToFine()? "enabled": "disabled");
+	}
+	if (e->key.keysym.sym == SDLK_m) {
+		// query latency with and without the coarse stage
+		CPathFinder::BenchmarkCoarseToFine(128, 1.5f, 3.0f, 8);
+	}
+	if (e->key.keysym.sym == SDLK_y) {
+		// cycle search recording: off -> ring -> file -> off
+		static const char* modeNames[] = {"off", "ring", "file (search.trace)"};
+
+		CSearchTrace& trace = simThread->GetPathFinder()->trace;
+		const traceMode mode = traceMode((trace.GetMode() + 1) % 3);
+
+		if (trace.SetMode(mode, "search.trace")) {
+			printf("search trace %s\n", modeNames[mode]);
+		}
 	}
 	if (e->key.keysym.sym == SDLK_l) { renderThread->ToggleLighting(); }
 	if (e->key.keysym.sym == SDLK_t) { renderThread->ToggleTracking(); }
@@ -1,23 +1,25 @@
 #ifndef SCOPEDTIMER_HPP
 #define SCOPEDTIMER_HPP
 
-#include <string>
+#include <cstdio>
 #include <SDL/SDL_timer.h>
 
 class ScopedTimer {
 	public:
-		ScopedTimer(const std::string& s): task(s), t1(SDL_GetTicks()) {
+		// <s> must outlive the timer (a literal, normally), so
+		// timing something costs no allocation
+		ScopedTimer(const char* s): task(s), t1(SDL_GetTicks()) {
 		}
 
 		~ScopedTimer() {
 			t2 = SDL_GetTicks();
 			t3 = t2 - t1;
 
-			printf("%s: %u msecs\n", task.c_str(), t3);
+			printf("%s: %u msecs\n", task, t3);
 		}
 
 	private:
-		const std::string task;
+		const char* task;
 		unsigned int t1;
 		unsigned int t2;
 		unsigned int t3;
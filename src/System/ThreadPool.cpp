@@ -0,0 +1,113 @@
+#include <algorithm>
+
+#include "./ThreadPool.hpp"
+
+CThreadPool::CThreadPool(unsigned int numThreads) {
+	jobFunc = 0x0;
+	jobData = 0x0;
+	jobChunks = 0;
+	jobCount = 0;
+	numBusy = 0;
+	quit = false;
+
+	nextChunk.store(0);
+
+	SetNumThreads(numThreads);
+}
+
+CThreadPool::~CThreadPool() {
+	Stop();
+}
+
+void CThreadPool::SetNumThreads(unsigned int n) {
+	if (n == 0) {
+		n = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	if (n == GetNumThreads())
+		return;
+
+	Stop();
+
+	quit = false;
+
+	// the caller is the n-th
+	for (unsigned int t = 1; t < n; t++) {
+		workers.push_back(std::thread(&CThreadPool::Work, this, jobCount));
+	}
+}
+
+void CThreadPool::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+
+	wake.notify_all();
+
+	for (unsigned int t = 0; t < workers.size(); t++) {
+		workers[t].join();
+	}
+
+	workers.clear();
+}
+
+
+
+void CThreadPool::Dispatch(unsigned int numChunks, void (*func)(void*, unsigned int), void* data) {
+	// not worth waking anyone for
+	if (workers.empty() || numChunks <= 1) {
+		for (unsigned int c = 0; c < numChunks; c++) {
+			func(data, c);
+		}
+
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		jobFunc = func;
+		jobData = data;
+		jobChunks = numChunks;
+		jobCount += 1;
+		numBusy = workers.size();
+
+		nextChunk.store(0);
+	}
+
+	wake.notify_all();
+
+	RunChunks();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this]() { return (numBusy == 0); });
+}
+
+void CThreadPool::Work(unsigned int lastJob) {
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]() { return (quit || jobCount != lastJob); });
+
+			if (quit)
+				return;
+
+			lastJob = jobCount;
+		}
+
+		RunChunks();
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if ((--numBusy) == 0) {
+			done.notify_one();
+		}
+	}
+}
+
+void CThreadPool::RunChunks() {
+	for (unsigned int c = nextChunk.fetch_add(1); c < jobChunks; c = nextChunk.fetch_add(1)) {
+		jobFunc(jobData, c);
+	}
+}
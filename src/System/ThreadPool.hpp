@@ -0,0 +1,57 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// threads that are started once and sleep between jobs; a
+// job is a number of chunks that the threads and the caller
+// take in turn, so which thread runs a chunk varies but the
+// chunks themselves do not (results that only depend on the
+// chunks are the same for any number of threads)
+class CThreadPool {
+	public:
+		// 0: one thread per hardware thread, the caller included
+		CThreadPool(unsigned int numThreads = 0);
+		~CThreadPool();
+
+		void SetNumThreads(unsigned int n);
+		unsigned int GetNumThreads() const { return (workers.size() + 1); }
+
+		// calls f(c) for every c in [0, numChunks) and returns
+		// when all calls did (one job at a time, so f may not
+		// call Run on the same pool)
+		template<typename F> void Run(unsigned int numChunks, F f) { Dispatch(numChunks, &Call<F>, &f); }
+
+	private:
+		template<typename F> static void Call(void* f, unsigned int c) { (*static_cast<F*>(f))(c); }
+
+		void Dispatch(unsigned int numChunks, void (*func)(void*, unsigned int), void* data);
+		// <lastJob>: the job count when the thread started
+		void Work(unsigned int lastJob);
+		void RunChunks();
+		void Stop();
+
+		std::vector<std::thread> workers;
+
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable done;
+
+		// the current job; written under <mutex> before the
+		// workers are woken, only read while they run it
+		void (*jobFunc)(void*, unsigned int);
+		void* jobData;
+		unsigned int jobChunks;
+		unsigned int jobCount;
+
+		unsigned int numBusy;
+		bool quit;
+
+		std::atomic<unsigned int> nextChunk;
+};
+
+#endif